@@ -0,0 +1,56 @@
+#include "alloc_tracker.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Replaces the global allocation functions for the benchmark program. Each block is prefixed
+// with its size so live and peak bytes can be tracked.
+
+static std::atomic<std::size_t> g_allocations(0);
+static std::atomic<std::size_t> g_live(0);
+static std::atomic<std::size_t> g_peak(0);
+
+static constexpr std::size_t header_size = alignof(std::max_align_t);
+
+std::size_t alloc_tracker::allocations() { return g_allocations.load(); }
+std::size_t alloc_tracker::live_bytes() { return g_live.load(); }
+std::size_t alloc_tracker::peak_bytes() { return g_peak.load(); }
+void alloc_tracker::reset_peak() { g_peak.store(g_live.load()); }
+
+static void* tracked_alloc(std::size_t size) {
+    auto* block = static_cast<unsigned char*>(std::malloc(size + header_size));
+    if (block == nullptr) return nullptr;
+
+    *reinterpret_cast<std::size_t*>(block) = size;
+    ++g_allocations;
+
+    std::size_t live = g_live += size;
+    std::size_t peak = g_peak.load();
+    while (live > peak && !g_peak.compare_exchange_weak(peak, live)) {
+    }
+    return block + header_size;
+}
+
+static void tracked_free(void* p) {
+    if (p == nullptr) return;
+    auto* block = static_cast<unsigned char*>(p) - header_size;
+    g_live -= *reinterpret_cast<std::size_t*>(block);
+    std::free(block);
+}
+
+void* operator new(std::size_t size) {
+    if (void* p = tracked_alloc(size)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) {
+    if (void* p = tracked_alloc(size)) return p;
+    throw std::bad_alloc();
+}
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return tracked_alloc(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return tracked_alloc(size); }
+
+void operator delete(void* p) noexcept { tracked_free(p); }
+void operator delete[](void* p) noexcept { tracked_free(p); }
+void operator delete(void* p, std::size_t) noexcept { tracked_free(p); }
+void operator delete[](void* p, std::size_t) noexcept { tracked_free(p); }
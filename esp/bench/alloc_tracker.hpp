@@ -0,0 +1,35 @@
+#pragma once
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+
+namespace alloc_tracker {
+
+// Calls to the global operator new since the program started
+std::size_t allocations();
+// Bytes currently allocated through the global operator new
+std::size_t live_bytes();
+// Highest live_bytes() since the last reset_peak()
+std::size_t peak_bytes();
+void reset_peak();
+
+// Create before the benchmark loop; report() adds per iteration allocations and the peak heap
+// above what was live when it was created.
+class heap_counters {
+    std::size_t _allocations;
+    std::size_t _live;
+
+    public:
+    heap_counters() : _allocations(allocations()), _live(live_bytes()) { reset_peak(); }
+
+    void report(benchmark::State& state) const {
+        // Read before touching state.counters, inserting into it allocates
+        std::size_t allocs = allocations() - _allocations;
+        std::size_t peak = peak_bytes() - _live;
+        state.counters["allocs"] = benchmark::Counter(static_cast<double>(allocs), benchmark::Counter::kAvgIterations);
+        state.counters["peak_heap"] = static_cast<double>(peak);
+    }
+};
+
+}
@@ -0,0 +1,19 @@
+#include <benchmark/benchmark.h>
+#include <Config.hpp>
+
+#include "alloc_tracker.hpp"
+#include "payloads.hpp"
+
+static void BM_ConfigParse(benchmark::State& state) {
+    auto body = payloads::config(state.range(0));
+    alloc_tracker::heap_counters heap;
+
+    for (auto _ : state) {
+        config::Config conf;
+        benchmark::DoNotOptimize(config::parse(body, &conf));
+    }
+
+    heap.report(state);
+    state.SetBytesProcessed(state.iterations() * body.size());
+}
+BENCHMARK(BM_ConfigParse)->RangeMultiplier(10)->Range(1, 10000);
@@ -0,0 +1,138 @@
+#include <benchmark/benchmark.h>
+#include <NextStopClient.hpp>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "alloc_tracker.hpp"
+#include "payloads.hpp"
+
+using namespace next_stop;
+
+static const char* timestamp = "1674785282";
+
+#define ENTRIES RangeMultiplier(10)->Range(1, 10000)
+
+static void BM_Parse(benchmark::State& state) {
+    auto body = payloads::arrivals(state.range(0));
+    alloc_tracker::heap_counters heap;
+
+    for (auto _ : state) {
+        auto result = parse(body, argument<std::string>("direction"), argument<int64_t>("arriving_at_timestamp"));
+        benchmark::DoNotOptimize(result.data());
+    }
+
+    heap.report(state);
+    state.SetBytesProcessed(state.iterations() * body.size());
+}
+BENCHMARK(BM_Parse)->ENTRIES;
+
+static void BM_NextMinutes(benchmark::State& state) {
+    auto body = payloads::arrivals(state.range(0));
+    alloc_tracker::heap_counters heap;
+
+    for (auto _ : state) {
+        auto minutes = next_minutes(timestamp, body);
+        benchmark::DoNotOptimize(minutes.data());
+    }
+
+    heap.report(state);
+    state.SetBytesProcessed(state.iterations() * body.size());
+}
+BENCHMARK(BM_NextMinutes)->ENTRIES;
+
+// Output iterator overload, with room for every entry
+static void BM_NextMinutesOutputIterator(benchmark::State& state) {
+    auto body = payloads::arrivals(state.range(0));
+    std::vector<int> minutes(state.range(0));
+    alloc_tracker::heap_counters heap;
+
+    for (auto _ : state) {
+        auto count = try_next_minutes(timestamp, body, minutes.begin(), minutes.size());
+        benchmark::DoNotOptimize(count);
+        benchmark::ClobberMemory();
+    }
+
+    heap.report(state);
+    state.SetBytesProcessed(state.iterations() * body.size());
+}
+BENCHMARK(BM_NextMinutesOutputIterator)->ENTRIES;
+
+// What the device does: only the first 3 are kept
+static void BM_NextMinutesTop3(benchmark::State& state) {
+    auto body = payloads::arrivals(state.range(0));
+    int minutes[3];
+    alloc_tracker::heap_counters heap;
+
+    for (auto _ : state) {
+        auto count = next_minutes_top_k<3>(timestamp, body, minutes, direction_is{"117S"});
+        benchmark::DoNotOptimize(count);
+        benchmark::DoNotOptimize(minutes);
+    }
+
+    heap.report(state);
+}
+BENCHMARK(BM_NextMinutesTop3)->ENTRIES;
+
+// Throwing vs error code reporting on a valid body and on a truncated one. Both sides run the
+// chunked parser behind try_next_minutes, so only the cost of reporting through an exception
+// instead of result<T> differs.
+
+static std::size_t next_minutes_or_throw(const std::string& body, int* minutes, std::size_t capacity) {
+    auto count = try_next_minutes(timestamp, body, minutes, capacity);
+    if (!count) throw std::invalid_argument(std::string("next_stop: ") + describe(count.error()));
+    return count.value();
+}
+
+static void BM_NextMinutesThrowing(benchmark::State& state) {
+    auto body = payloads::arrivals(state.range(0));
+    int minutes[8];
+
+    for (auto _ : state) {
+        auto count = next_minutes_or_throw(body, minutes, 8);
+        benchmark::DoNotOptimize(count);
+        benchmark::DoNotOptimize(minutes);
+    }
+}
+BENCHMARK(BM_NextMinutesThrowing)->Arg(6);
+
+static void BM_NextMinutesErrorCode(benchmark::State& state) {
+    auto body = payloads::arrivals(state.range(0));
+    int minutes[8];
+
+    for (auto _ : state) {
+        auto count = try_next_minutes(timestamp, body, minutes, 8);
+        benchmark::DoNotOptimize(count);
+        benchmark::DoNotOptimize(minutes);
+    }
+}
+BENCHMARK(BM_NextMinutesErrorCode)->Arg(6);
+
+static void BM_TruncatedThrowing(benchmark::State& state) {
+    auto body = payloads::arrivals(state.range(0));
+    body.resize(body.size() / 2);
+    int minutes[8];
+
+    for (auto _ : state) {
+        try {
+            auto count = next_minutes_or_throw(body, minutes, 8);
+            benchmark::DoNotOptimize(count);
+        } catch (const std::invalid_argument& e) {
+            benchmark::DoNotOptimize(e.what());
+        }
+    }
+}
+BENCHMARK(BM_TruncatedThrowing)->Arg(6);
+
+static void BM_TruncatedErrorCode(benchmark::State& state) {
+    auto body = payloads::arrivals(state.range(0));
+    body.resize(body.size() / 2);
+    int minutes[8];
+
+    for (auto _ : state) {
+        auto count = try_next_minutes(timestamp, body, minutes, 8);
+        benchmark::DoNotOptimize(count);
+    }
+}
+BENCHMARK(BM_TruncatedErrorCode)->Arg(6);
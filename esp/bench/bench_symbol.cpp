@@ -0,0 +1,85 @@
+#include <benchmark/benchmark.h>
+#include <symbol.hpp>
+
+#include "alloc_tracker.hpp"
+
+// Columns of a SymbolArray holding `glyphs` digits, walked the way drawSymbol does
+static void BM_SymbolArrayRowsIter(benchmark::State& state) {
+    static symbol::SymbolArray<10000> symbols;
+    symbols.clear();
+    for (int i = 0; i < state.range(0); i++) symbols.append(*symbol::SYM_NUMERIC[i % 10]);
+    alloc_tracker::heap_counters heap;
+
+    for (auto _ : state) {
+        int columns = 0;
+        for (auto row : symbols.rows_iter()) {
+            benchmark::DoNotOptimize(row);
+            columns++;
+        }
+        benchmark::DoNotOptimize(columns);
+    }
+
+    heap.report(state);
+}
+BENCHMARK(BM_SymbolArrayRowsIter)->RangeMultiplier(10)->Range(1, 10000);
+
+// Formats the numbers 1..n into one bitmap, as LoopState::reset does for the arrivals.
+// 1..10000 has 38,894 digits, at most 7 columns each with its gap, plus 3 columns per number.
+static void BM_FormatNumber(benchmark::State& state) {
+    static symbol::ColumnBitmap<7 * 38894 + 3 * 10000> minutes;
+    alloc_tracker::heap_counters heap;
+
+    for (auto _ : state) {
+        minutes.clear();
+        for (int n = 1; n <= state.range(0); n++) {
+            symbol::format_number(minutes, n);
+            minutes.append_blank(3);
+        }
+        benchmark::DoNotOptimize(minutes.cols());
+    }
+
+    heap.report(state);
+}
+BENCHMARK(BM_FormatNumber)->RangeMultiplier(10)->Range(1, 10000);
+
+// A 32-column window out of a pre-rendered `glyphs` digits, the way a scrolled frame is drawn
+static void BM_ColumnBitmapSlice(benchmark::State& state) {
+    static symbol::SymbolArray<10000> symbols;
+    static symbol::ColumnBitmap<60000> bitmap;
+    symbols.clear();
+    for (int i = 0; i < state.range(0); i++) symbols.append(*symbol::SYM_NUMERIC[i % 10]);
+    bitmap.render(symbols);
+    alloc_tracker::heap_counters heap;
+
+    for (auto _ : state) {
+        int columns = 0;
+        for (auto row : bitmap.slice(bitmap.cols() / 2, bitmap.cols() / 2 + 32)) {
+            benchmark::DoNotOptimize(row);
+            columns++;
+        }
+        benchmark::DoNotOptimize(columns);
+    }
+
+    heap.report(state);
+}
+BENCHMARK(BM_ColumnBitmapSlice)->RangeMultiplier(10)->Range(1, 10000);
+
+// The same window read straight out of the glyphs, skipping the ones before it
+static void BM_SymbolArraySlice(benchmark::State& state) {
+    static symbol::SymbolArray<10000> symbols;
+    symbols.clear();
+    for (int i = 0; i < state.range(0); i++) symbols.append(*symbol::SYM_NUMERIC[i % 10]);
+    alloc_tracker::heap_counters heap;
+
+    for (auto _ : state) {
+        int columns = 0;
+        for (auto row : symbols.slice(symbols.cols() / 2, symbols.cols() / 2 + 32)) {
+            benchmark::DoNotOptimize(row);
+            columns++;
+        }
+        benchmark::DoNotOptimize(columns);
+    }
+
+    heap.report(state);
+}
+BENCHMARK(BM_SymbolArraySlice)->RangeMultiplier(10)->Range(1, 10000);
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Synthetic inputs shaped like what the server and the config file hold
+
+namespace payloads {
+
+constexpr int64_t sample_ts = 1674785282;
+
+// `entries` arrivals, one every 30 seconds, alternating directions
+inline std::string arrivals(std::size_t entries) {
+    std::string body = "[";
+    for (std::size_t i = 0; i < entries; i++) {
+        auto ts = std::to_string(sample_ts + 30 * static_cast<int64_t>(i));
+        if (i > 0) body += ",";
+        body += R"({"stop":"116 St-Columbia University","line":"1","direction":")";
+        body += (i % 2 == 0) ? "117N" : "117S";
+        body += R"(","leaving_at_timestamp":)" + ts + R"(,"arriving_at_timestamp":)" + ts + "}";
+    }
+    return body + "]";
+}
+
+inline std::string config(std::size_t stops) {
+    std::string body = R"({"active_stop": 0, "connection": {"ssid": "ssid", "password": "password"}, "stops": [)";
+    for (std::size_t i = 0; i < stops; i++) {
+        if (i > 0) body += ",";
+        body += R"({"name": "1 Train", "direction": ")";
+        body += (i % 2 == 0) ? "South" : "North";
+        body += R"(", "url": "http://192.168.1.5:3000/next_train/from/116%20St-Columbia%20University/direction/117S?future_only=true&limit_direction_departures=3"})";
+    }
+    return body + "]}";
+}
+
+}
@@ -0,0 +1,24 @@
+#!/bin/sh
+# Builds the fuzz targets into fuzz/out.
+# With clang: libFuzzer binaries with ASan/UBSan. Otherwise: replay-only binaries
+# (standalone_main.cpp) with the same sanitizers, for running the corpus; out/REPLAY marks
+# those so run.sh and minimize.sh don't hand them libFuzzer options.
+set -e
+cd "$(dirname "$0")/.."
+
+OUT=fuzz/out
+mkdir -p "$OUT"
+INCLUDES="-Ilib/json -Ilib/NextStopClient -Ilib/Config -Ilib/symbol"
+# float-cast-overflow isn't part of undefined, it catches out of range numbers cast to integers
+FLAGS="-std=gnu++17 -g -O1 -fsanitize=address,undefined,float-cast-overflow -fno-sanitize-recover=undefined,float-cast-overflow"
+
+rm -f "$OUT/REPLAY"
+command -v clang++ >/dev/null 2>&1 || touch "$OUT/REPLAY"
+
+for target in next_stop config; do
+    if command -v clang++ >/dev/null 2>&1; then
+        clang++ $FLAGS -fsanitize=fuzzer $INCLUDES "fuzz/fuzz_$target.cpp" -o "$OUT/fuzz_$target"
+    else
+        g++ $FLAGS $INCLUDES "fuzz/fuzz_$target.cpp" fuzz/standalone_main.cpp -o "$OUT/fuzz_$target"
+    fi
+done
@@ -0,0 +1,17 @@
+#include <Config.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// libFuzzer entry point for config::parse, which reads the config file from flash.
+// It must reject bad input by returning false; any exception or abort is a finding.
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, std::size_t size) {
+    config::Config conf;
+    if (config::parse(std::string(reinterpret_cast<const char*>(data), size), &conf)) {
+        // What setup() relies on
+        if (conf.active_stop < 0 || static_cast<std::size_t>(conf.active_stop) >= conf.stops.size()) __builtin_trap();
+    }
+    return 0;
+}
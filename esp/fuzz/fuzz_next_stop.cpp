@@ -0,0 +1,47 @@
+#include <NextStopClient.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// libFuzzer entry point for the response parsers: the DOM-free SAX path, the chunked parser
+// fed in two pieces, the allocation-free minutes and top-K paths and the binary decoder.
+// Only the non-throwing API is exercised; any exception or abort is a finding.
+
+using namespace next_stop;
+
+namespace {
+
+struct count_sink {
+    std::size_t count = 0;
+    bool operator()(const std::tuple<std::string, int64_t>&) {
+        ++count;
+        return true;
+    }
+};
+
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, std::size_t size) {
+    const std::string body(reinterpret_cast<const char*>(data), size);
+
+    count_sink sax_sink;
+    for_each_element(body, sax_sink, argument<std::string>("direction"), argument<int64_t>("arriving_at_timestamp"));
+
+    // Split point taken from the input so chunk boundaries are explored too
+    std::size_t split = size == 0 ? 0 : data[size - 1] % (size + 1);
+    element_stream<count_sink, std::string, int64_t> stream(
+        count_sink{}, argument<std::string>("direction"), argument<int64_t>("arriving_at_timestamp"));
+    stream.feed(body.data(), split);
+    stream.feed(body.data() + split, size - split);
+    stream.finish();
+
+    int minutes[3];
+    try_next_minutes("1674785282", body, minutes, 3);
+    next_minutes_top_k<3>("1674785282", body, minutes, direction_is{"117N"}, order::unsorted);
+
+    auto arrivals = wire::arrivals_view::decode(data, size, true);
+    if (arrivals) wire::next_minutes(arrivals.value(), minutes, 3);
+
+    return 0;
+}
@@ -0,0 +1,20 @@
+#!/bin/sh
+# Merges the working corpus of a target into a minimal set covering the same edges and
+# replaces corpus/<target> with it: fuzz/minimize.sh next_stop|config
+set -e
+cd "$(dirname "$0")"
+
+TARGET=${1:?usage: minimize.sh next_stop|config}
+if [ -e out/REPLAY ]; then
+    echo "minimize.sh: needs the libFuzzer build, rerun build.sh with clang" >&2
+    exit 1
+fi
+MINIMIZED="corpus/$TARGET.min"
+
+rm -rf "$MINIMIZED"
+mkdir -p "$MINIMIZED" "work/$TARGET"
+"./out/fuzz_$TARGET" -merge=1 -timeout="${TIMEOUT:-1}" "$MINIMIZED" "corpus/$TARGET" "work/$TARGET"
+
+rm -rf "corpus/$TARGET"
+mv "$MINIMIZED" "corpus/$TARGET"
+echo "corpus/$TARGET: $(ls "corpus/$TARGET" | wc -l) inputs"
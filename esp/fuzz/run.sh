@@ -0,0 +1,27 @@
+#!/bin/sh
+# Fuzzes one target: fuzz/run.sh next_stop|config [seconds]
+# Inputs running longer than TIMEOUT seconds are reported as timeouts, and units taking at
+# least SLOW whole seconds are reported, so pathologically slow inputs surface next to crashes.
+# libFuzzer reads both as integers.
+set -e
+cd "$(dirname "$0")"
+
+TARGET=${1:?usage: run.sh next_stop|config [seconds]}
+TOTAL=${2:-60}
+TIMEOUT=${TIMEOUT:-1}
+SLOW=${SLOW:-1}
+
+mkdir -p "work/$TARGET" "findings/$TARGET"
+if [ -e out/REPLAY ]; then
+    # Built without clang: no mutation, only the corpus and earlier findings are replayed
+    echo "run.sh: replay build, replaying corpus/$TARGET" >&2
+    find "corpus/$TARGET" "work/$TARGET" -type f -exec "./out/fuzz_$TARGET" {} +
+    exit
+fi
+"./out/fuzz_$TARGET" "work/$TARGET" "corpus/$TARGET" \
+    -timeout="$TIMEOUT" \
+    -report_slow_units="$SLOW" \
+    -max_total_time="$TOTAL" \
+    -rss_limit_mb=512 \
+    -dict="dict/json.dict" \
+    -artifact_prefix="findings/$TARGET/"
@@ -0,0 +1,4 @@
+# PlatformIO passes -fsanitize from build_flags to the compiler only; the runtime has to be linked too
+Import("env")
+
+env.Append(LINKFLAGS=[flag for flag in env.get("CCFLAGS", []) if str(flag).startswith("-fsanitize")])
@@ -0,0 +1,34 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Replays inputs through a fuzz target without libFuzzer, for compilers that lack
+// -fsanitize=fuzzer: ./target file...
+// Without arguments, a build defining FUZZ_CORPUS replays every file in that directory.
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, std::size_t size);
+
+static void replay(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    std::vector<uint8_t> input((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    std::printf("Running %s (%zu bytes)\n", path.c_str(), input.size());
+    LLVMFuzzerTestOneInput(input.data(), input.size());
+}
+
+int main(int argc, char** argv) {
+#ifdef FUZZ_CORPUS
+    if (argc == 1) {
+        for (const auto& entry : std::filesystem::directory_iterator(FUZZ_CORPUS)) {
+            if (entry.is_regular_file()) replay(entry.path().string());
+        }
+        return 0;
+    }
+#endif
+    for (int i = 1; i < argc; i++) replay(argv[i]);
+    return 0;
+}
@@ -22,25 +22,57 @@ struct Config {
   std::vector<Stop> stops;
 };
 
+// Member `key` of `obj` when it holds a value of `type`, nullptr otherwise
+inline const nlohmann::json* member(const nlohmann::json& obj, const char* key, nlohmann::json::value_t type) {
+  auto it = obj.find(key);
+  if (it == obj.end() || it->type() != type) return nullptr;
+  return &*it;
+}
+
+// Returns false, without throwing, when the input isn't a valid config.
+// The config comes from flash and may be corrupted; a throw would reboot the device.
 template <class Inp>
 bool parse(Inp&& inp, Config* conf) {
-  auto parsed = nlohmann::json::parse(inp);
+  using value_t = nlohmann::json::value_t;
+
+  nlohmann::json parsed = nlohmann::json::parse(inp, nullptr, /* allow_exceptions */ false);
+  if (!parsed.is_object()) return false;
+
+  const nlohmann::json* stops = member(parsed, "stops", value_t::array);
+  const nlohmann::json* connection = member(parsed, "connection", value_t::object);
+  const nlohmann::json* active_stop = member(parsed, "active_stop", value_t::number_unsigned);
+  if (stops == nullptr || connection == nullptr || active_stop == nullptr) return false;
+
+  conf->stops.clear();
+  for (const auto& stop_obj : *stops) {
+    if (!stop_obj.is_object()) return false;
+
+    const nlohmann::json* url = member(stop_obj, "url", value_t::string);
+    const nlohmann::json* direction = member(stop_obj, "direction", value_t::string);
+    if (url == nullptr || direction == nullptr) return false;
 
-  conf->active_stop = parsed["active_stop"];
-  for (auto& stop_obj : parsed["stops"]) {
     Stop stop;
-    stop.url = stop_obj["url"];
+    stop.url = url->get<std::string>();
 
-    std::string dir_string = stop_obj["direction"];
+    const auto& dir_string = direction->get_ref<const std::string&>();
     if (dir_string == "South") stop.direction = Direction::South;
     else if (dir_string == "North") stop.direction =  Direction::North;
+    else stop.direction = Direction::Unknown;
 
     (conf->stops).push_back(stop);
   }
 
-  const auto& connection = parsed["connection"];
-  conf->connection.ssid = connection["ssid"];
-  conf->connection.password = connection["password"];
+  // The firmware indexes stops with it
+  auto active = active_stop->get<uint64_t>();
+  if (active >= conf->stops.size()) return false;
+  conf->active_stop = static_cast<int>(active);
+
+  const nlohmann::json* ssid = member(*connection, "ssid", value_t::string);
+  const nlohmann::json* password = member(*connection, "password", value_t::string);
+  if (ssid == nullptr || password == nullptr) return false;
+
+  conf->connection.ssid = ssid->get<std::string>();
+  conf->connection.password = password->get<std::string>();
 
   return true;
 }
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace frame {
+
+// What one 8-pixel column shows: bit i lights row i in `color`
+template <class Color>
+struct column_state {
+  uint8_t bits;
+  Color color;
+
+  // A blank column looks the same whatever its color
+  bool operator==(const column_state& rhs) const {
+    return bits == rhs.bits && (bits == 0 || color == rhs.color);
+  }
+  bool operator!=(const column_state& rhs) const { return !(*this == rhs); }
+};
+
+// Collects the columns drawn for the next frame and, on flush, hands out only the ones that
+// differ from what was last flushed. An unchanged frame flushes nothing, so it needn't be shown.
+template <class Color, std::size_t Cols>
+class DirtyColumns {
+  column_state<Color> _next[Cols];
+  column_state<Color> _shown[Cols];
+  // False until the first flush, and after invalidate(): every column is written
+  bool _synced;
+
+  public:
+  DirtyColumns() : _next(), _shown(), _synced(false) {}
+
+  static constexpr std::size_t cols() { return Cols; }
+
+  // Blanks the next frame
+  void clear() {
+    for (auto& c : _next) c = column_state<Color>{};
+  }
+
+  // Columns past the frame are ignored
+  void draw(std::size_t col, uint8_t bits, const Color& color) {
+    if (col < Cols) _next[col] = column_state<Color>{bits, color};
+  }
+
+  // Forces the next flush to write every column, e.g. after the pixels were changed elsewhere
+  void invalidate() { _synced = false; }
+
+  // Calls write(col, bits, color) for every column that changed since the last flush and
+  // returns how many did
+  template <class F>
+  std::size_t flush(F&& write) {
+    std::size_t changed = 0;
+    for (std::size_t col = 0; col < Cols; col++) {
+      if (_synced && _next[col] == _shown[col]) continue;
+
+      write(col, _next[col].bits, _next[col].color);
+      _shown[col] = _next[col];
+      changed++;
+    }
+    _synced = true;
+    return changed;
+  }
+};
+
+// How a display is mounted, relative to the way its panels are wired
+enum class rotation { none, cw90, cw180, cw270 };
+
+// Geometry of a display made of identical LED panels. Panels are chained left to right, then top
+// to bottom; inside a panel the LEDs run in strips along its columns or rows.
+struct panel_layout {
+  std::size_t panel_cols;
+  std::size_t panel_rows;
+  std::size_t panels_x = 1;
+  std::size_t panels_y = 1;
+  // Strips run along columns (top to bottom) rather than rows (left to right)
+  bool column_major = true;
+  // Every other strip runs back the other way
+  bool serpentine = true;
+  // The first strip runs bottom to top, or right to left
+  bool reversed = false;
+  rotation rotate = rotation::none;
+
+  constexpr std::size_t leds() const { return panel_cols * panels_x * panel_rows * panels_y; }
+  constexpr bool sideways() const { return rotate == rotation::cw90 || rotate == rotation::cw270; }
+  // Size as seen, after rotation
+  constexpr std::size_t width() const { return sideways() ? panel_rows * panels_y : panel_cols * panels_x; }
+  constexpr std::size_t height() const { return sideways() ? panel_cols * panels_x : panel_rows * panels_y; }
+
+  // Index of the LED at column x, row y of the display as seen
+  constexpr std::size_t led(std::size_t x, std::size_t y) const {
+    const std::size_t cols = panel_cols * panels_x;
+    const std::size_t rows = panel_rows * panels_y;
+
+    // Back to the wired orientation
+    std::size_t px = x, py = y;
+    switch (rotate) {
+      case rotation::none: break;
+      case rotation::cw90: px = y; py = rows - 1 - x; break;
+      case rotation::cw180: px = cols - 1 - x; py = rows - 1 - y; break;
+      case rotation::cw270: px = cols - 1 - y; py = x; break;
+    }
+
+    const std::size_t panel = (py / panel_rows) * panels_x + px / panel_cols;
+    const std::size_t lx = px % panel_cols;
+    const std::size_t ly = py % panel_rows;
+
+    const std::size_t strip = column_major ? lx : ly;
+    const std::size_t length = column_major ? panel_rows : panel_cols;
+    std::size_t pos = column_major ? ly : lx;
+
+    bool backwards = reversed != (serpentine && strip % 2 == 1);
+    if (backwards) pos = length - 1 - pos;
+
+    return panel * panel_cols * panel_rows + strip * length + pos;
+  }
+};
+
+// (x, y) -> LED index lookup table for a layout, built at compile time when the layout is a constant
+template <std::size_t Width, std::size_t Height>
+class PixelMap {
+  uint16_t _index[Height][Width];
+
+  public:
+  constexpr explicit PixelMap(const panel_layout& layout) : _index() {
+    for (std::size_t y = 0; y < Height; y++) {
+      for (std::size_t x = 0; x < Width; x++) {
+        _index[y][x] = static_cast<uint16_t>(layout.led(x, y));
+      }
+    }
+  }
+
+  static constexpr std::size_t width() { return Width; }
+  static constexpr std::size_t height() { return Height; }
+
+  constexpr uint16_t operator()(std::size_t x, std::size_t y) const { return _index[y][x]; }
+};
+
+}
+
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <NextStopClient.hpp>
+
+#include <algorithm>
+#include <cstddef>
+
+namespace next_stop {
+
+    // Keeps up to N absolute arrival timestamps and counts down to them between polls. The server
+    // clock is tracked as the offset from the device's millis() at the last sync, so the minutes
+    // stay current for as long as the arrivals do. Arrivals whose time has passed are dropped.
+    template <std::size_t N>
+    class countdown {
+        timestamp_t _arrivals[N];
+        std::size_t _count = 0;
+
+        timestamp_t _synced_ts = 0;
+        unsigned long _synced_ms = 0;
+        bool _synced = false;
+
+        public:
+        // `sample_ts` is the server time observed at device time `now_ms`
+        void sync(timestamp_t sample_ts, unsigned long now_ms) {
+            _synced_ts = sample_ts;
+            _synced_ms = now_ms;
+            _synced = true;
+        }
+
+        // Replaces the arrivals, keeping the first N in arrival order
+        void assign(const timestamp_t* arrivals, std::size_t count) {
+            _count = std::min(count, N);
+            std::partial_sort_copy(arrivals, arrivals + count, _arrivals, _arrivals + _count);
+        }
+
+        void clear() { _count = 0; }
+
+        bool synced() const { return _synced; }
+        std::size_t size() const { return _count; }
+        bool empty() const { return _count == 0; }
+        timestamp_t operator[](std::size_t i) const { return _arrivals[i]; }
+
+        // Server time at device time `now_ms`. millis() wraps after ~49 days, the unsigned
+        // difference stays right as long as syncs are more frequent than that.
+        timestamp_t server_time(unsigned long now_ms) const {
+            return _synced_ts + static_cast<timestamp_t>((now_ms - _synced_ms) / 1000);
+        }
+
+        // Drops the arrivals that have passed, then writes the minutes until at most `capacity` of
+        // the rest to `out`. Returns how many were written.
+        template <class OutputIt>
+        std::size_t minutes(unsigned long now_ms, OutputIt out, std::size_t capacity) {
+            if (!_synced) return 0;
+            timestamp_t now = server_time(now_ms);
+
+            // Sorted, so the departed ones lead; shift the upcoming ones to the front
+            auto upcoming = std::find_if(_arrivals, _arrivals + _count, [now](timestamp_t at) { return at >= now; });
+            _count = std::copy(upcoming, _arrivals + _count, _arrivals) - _arrivals;
+
+            std::size_t written = std::min(_count, capacity);
+            for (std::size_t i = 0; i < written; i++, ++out) *out = minutes_until(_arrivals[i], now);
+            return written;
+        }
+    };
+}
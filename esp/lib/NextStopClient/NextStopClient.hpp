@@ -1,16 +1,122 @@
 #pragma once
 
 #include <json.hpp>
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+// The ESP8266 firmware is built with -fno-exceptions; the throwing API is only offered when
+// exceptions are available. The try_* functions never throw.
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS)
+#define NEXT_STOP_EXCEPTIONS 1
+#else
+#define NEXT_STOP_EXCEPTIONS 0
+#endif
+
 namespace next_stop {
 
     using json = nlohmann::json;
     using timestamp_t = int64_t;
 
-    timestamp_t parse_timestamp(const std::string& timestamp) {
+    enum class error_code {
+        none,
+        bad_header,     // missing or malformed x-timestamp
+        malformed_body,
+        truncated_body,
+        wrong_type,     // a requested key holds a value of another type
+        missing_key,    // an element lacks a requested key
+        too_large,      // a requested value or the nesting exceeds the parser's buffers
+        bad_url,        // not an http://host[:port][/path] URL, or too long to keep
+        connection_failed,
+        timed_out,
+        bad_status      // the server answered with something other than 200 or 304
+    };
+
+    inline const char* describe(error_code error) {
+        switch (error) {
+            case error_code::none: return "none";
+            case error_code::bad_header: return "bad header";
+            case error_code::malformed_body: return "malformed body";
+            case error_code::truncated_body: return "truncated body";
+            case error_code::wrong_type: return "wrong type";
+            case error_code::missing_key: return "missing key";
+            case error_code::too_large: return "value too large";
+            case error_code::bad_url: return "bad url";
+            case error_code::connection_failed: return "connection failed";
+            case error_code::timed_out: return "timed out";
+            case error_code::bad_status: return "bad status";
+        }
+        return "unknown";
+    }
+
+    // expected-style outcome: a value, or the error_code explaining why there is none
+    template <class T>
+    class result {
+        T _value;
+        error_code _error;
+
+        public:
+        constexpr result(T value) : _value(std::move(value)), _error(error_code::none) {}
+        constexpr result(error_code error) : _value(), _error(error) {}
+
+        constexpr bool has_value() const { return _error == error_code::none; }
+        constexpr explicit operator bool() const { return has_value(); }
+
+        constexpr const T& value() const { return _value; }
+        constexpr T value_or(T fallback) const { return has_value() ? _value : fallback; }
+        constexpr error_code error() const { return _error; }
+    };
+
+    inline result<timestamp_t> try_parse_timestamp(std::string_view timestamp) {
+        timestamp_t value = 0;
+        auto [end, ec] = std::from_chars(timestamp.data(), timestamp.data() + timestamp.size(), value);
+        if (timestamp.empty() || ec != std::errc() || end != timestamp.data() + timestamp.size()) {
+            return error_code::bad_header;
+        }
+        return value;
+    }
+
+#if NEXT_STOP_EXCEPTIONS
+    inline timestamp_t parse_timestamp(const std::string& timestamp) {
         return std::stoll(timestamp);
     }
+#endif
+
+    // 0 when the timestamp can't be parsed; see try_parse_timestamp
+    inline timestamp_t parse_timestamp(const char* timestamp) {
+        return try_parse_timestamp(timestamp).value_or(0);
+    }
+
+    // Whole minutes from `sample_ts` to `at`, clamped to int; the body's timestamps are untrusted
+    inline int minutes_until(timestamp_t at, timestamp_t sample_ts) {
+        timestamp_t seconds;
+        if (__builtin_sub_overflow(at, sample_ts, &seconds)) {
+            return at < sample_ts ? std::numeric_limits<int>::min() : std::numeric_limits<int>::max();
+        }
+        timestamp_t minutes = seconds / 60;
+        return static_cast<int>(std::clamp<timestamp_t>(minutes, std::numeric_limits<int>::min(),
+                                                        std::numeric_limits<int>::max()));
+    }
+
+    // Contiguous view over the body types callers hand us (literals, std::string, Arduino String)
+    template <class Input>
+    std::string_view body_view(const Input& body) {
+        if constexpr (std::is_convertible<const Input&, std::string_view>::value) {
+            return body;
+        } else {
+            return std::string_view(body.c_str(), body.length());
+        }
+    }
 
     // template <class Input, typename... Types>
     // void parse(Input&& text, const Types&& ...keys) {
@@ -24,53 +130,1050 @@ namespace next_stop {
 
     template <class T>
     struct argument {
-        const char* key;
-        argument(const char* _key) : key(_key) {}
+        std::string_view key;
+        constexpr argument(const char* _key) : key(_key) {}
     };
 
-    template <class J, class... Ts>
-    std::tuple<Ts...> extract_key(J&& obj, const argument<Ts>&&... args) {
-        return std::make_tuple(
-            std::move(obj[args.key].template get<Ts>())...
-        );
+    // The fixed set of keys an extraction looks for, with their value types.
+    // Keys are dispatched on their length and first/last characters through a small hash table
+    // whose seed is searched when the schema is built, so a `constexpr` schema is resolved at
+    // compile time. Matching an incoming key costs one hash and (with a perfect seed) one
+    // compare, however many unrelated keys the server adds.
+    template <class... Ts>
+    class key_schema {
+        public:
+        static constexpr std::size_t size = sizeof...(Ts);
+        static constexpr std::size_t npos = size;
+
+        private:
+        static constexpr std::size_t table_size = [] {
+            std::size_t n = 2;
+            while (n < 2 * size) n *= 2;
+            return n;
+        }();
+        static constexpr uint8_t empty = 0xFF;
+        static constexpr unsigned max_seed = 64;
+
+        static_assert(size < empty, "Too many keys requested");
+
+        std::array<std::string_view, size> _keys;
+        std::array<uint8_t, table_size> _table;
+        unsigned _seed;
+        std::size_t _probes; // longest probe sequence, 1 when the hash is perfect
+
+        static constexpr std::size_t hash(std::string_view key, unsigned seed) {
+            if (key.empty()) return 0;
+            auto first = static_cast<unsigned char>(key.front());
+            auto last = static_cast<unsigned char>(key.back());
+            return (key.size() * 31u + first * (seed + 1u) + last * (2u * seed + 3u)) & (table_size - 1);
+        }
+
+        // Fills the table for `seed`, returning the longest probe sequence
+        constexpr std::size_t fill(unsigned seed) {
+            for (auto& slot : _table) slot = empty;
+
+            std::size_t probes = 0;
+            for (std::size_t i = 0; i < size; i++) {
+                std::size_t h = hash(_keys[i], seed);
+                std::size_t n = 1;
+                while (_table[h] != empty) {
+                    h = (h + 1) & (table_size - 1);
+                    n++;
+                }
+                _table[h] = static_cast<uint8_t>(i);
+                probes = std::max(probes, n);
+            }
+            return probes;
+        }
+
+        public:
+        constexpr key_schema(const argument<Ts>&... args) : _keys{args.key...}, _table{}, _seed(0), _probes(0) {
+            std::size_t best = table_size + 1;
+            for (unsigned seed = 0; seed < max_seed && best > 1; seed++) {
+                auto probes = fill(seed);
+                if (probes < best) {
+                    best = probes;
+                    _seed = seed;
+                }
+            }
+            _probes = fill(_seed);
+        }
+
+        constexpr bool perfect() const { return _probes <= 1; }
+        constexpr std::string_view key(std::size_t i) const { return _keys[i]; }
+
+        // Index of `key` in the schema, npos when it isn't one of ours
+        constexpr std::size_t find(std::string_view key) const {
+            std::size_t h = hash(key, _seed);
+            for (std::size_t n = 0; n < _probes && _table[h] != empty; n++) {
+                if (_keys[_table[h]] == key) return _table[h];
+                h = (h + 1) & (table_size - 1);
+            }
+            return npos;
+        }
+    };
+
+    inline constexpr key_schema<timestamp_t> arriving_at_schema{argument<timestamp_t>("arriving_at_timestamp")};
+
+    inline constexpr key_schema<timestamp_t, std::string> arrival_schema{
+        argument<timestamp_t>("arriving_at_timestamp"),
+        argument<std::string>("direction")
+    };
+
+    // Whether `value` converts to T without loss of range. Integer slots only take whole numbers
+    // within their limits; the values come from the server, a cast out of range is undefined.
+    template <class T, class V>
+    bool fits(V value) {
+        if constexpr (std::is_floating_point<T>::value) {
+            return true;
+        } else if constexpr (std::is_floating_point<V>::value) {
+            if (!std::isfinite(value) || value != std::trunc(value)) return false;
+            // 2^digits is exact, and past the largest value of T
+            V limit = std::ldexp(V(1), std::numeric_limits<T>::digits);
+            return value < limit && (std::is_signed<T>::value ? value >= -limit : value >= 0);
+        } else if constexpr (std::is_signed<V>::value == std::is_signed<T>::value) {
+            return value >= std::numeric_limits<T>::min() && value <= std::numeric_limits<T>::max();
+        } else if constexpr (std::is_signed<V>::value) {
+            return value >= 0 && std::make_unsigned_t<V>(value) <= std::numeric_limits<T>::max();
+        } else {
+            return value <= std::make_unsigned_t<T>(std::numeric_limits<T>::max());
+        }
+    }
+
+    // Value conversion for SAX events. Arithmetic slots take any json number within their range,
+    // string slots take json strings; anything else is a type mismatch and leaves the slot as is.
+    template <class T, class V>
+    bool assign_value(T& slot, V&& value) {
+        using value_type = std::decay_t<V>;
+        if constexpr (std::is_arithmetic<T>::value && std::is_arithmetic<value_type>::value
+                      && !std::is_same<value_type, bool>::value) {
+            if constexpr (!std::is_same<T, bool>::value) {
+                if (!fits<T>(value)) return false;
+            }
+            slot = static_cast<T>(value);
+            return true;
+        } else if constexpr (std::is_same<T, bool>::value && std::is_same<value_type, bool>::value) {
+            slot = value;
+            return true;
+        } else if constexpr (std::is_constructible<T, V>::value && !std::is_arithmetic<value_type>::value
+                             && !std::is_same<value_type, std::nullptr_t>::value) {
+            slot = T(std::forward<V>(value));
+            return true;
+        } else {
+            return false;
+        }
+    }
+
+    enum class sax_status { ok, syntax_error, wrong_type, missing_key, stopped, truncated, too_large };
+
+    // json_sax handler walking an array of objects once.
+    // Only the requested keys of each top level object are written into a tuple, which is
+    // handed to `sink` when the object closes. Everything else (unknown keys, nested values)
+    // is skipped without being materialized. `sink` returns false to stop the walk.
+    template <class Sink, class... Ts>
+    class extract_sax {
+        static constexpr std::size_t npos = sizeof...(Ts);
+        static constexpr std::size_t element_depth = 2;
+
+        key_schema<Ts...> _schema;
+        Sink& _sink;
+
+        std::tuple<Ts...> _values;
+        std::size_t _depth = 0;
+        std::size_t _slot = npos;
+        uint32_t _seen = 0;
+        sax_status _status = sax_status::ok;
+
+        static_assert(sizeof...(Ts) <= 32, "Too many keys requested");
+        // One bit per key; shifted right, since shifting left by all 32 bits is undefined
+        static constexpr uint32_t all_seen = sizeof...(Ts) == 0 ? 0 : uint32_t(-1) >> (32 - sizeof...(Ts));
+
+        template <std::size_t I, class V>
+        static bool assign_slot(std::tuple<Ts...>& values, V value) {
+            return assign_value(std::get<I>(values), value);
+        }
+
+        template <class V, std::size_t... Is>
+        static constexpr auto make_setters(std::index_sequence<Is...>) {
+            return std::array<bool (*)(std::tuple<Ts...>&, V), sizeof...(Ts)>{&assign_slot<Is, V>...};
+        }
+
+        // Per value type, one setter per tuple slot: a matched value goes straight into its slot
+        template <class V>
+        static constexpr auto setters = make_setters<V>(std::index_sequence_for<Ts...>{});
+
+        template <class V>
+        bool value(V&& value) {
+            if (_depth != element_depth || _slot == npos) return true;
+
+            if (!setters<std::decay_t<V>>[_slot](_values, value)) {
+                _status = sax_status::wrong_type;
+                return false;
+            }
+            _seen |= (uint32_t(1) << _slot);
+            _slot = npos;
+            return true;
+        }
+
+        bool nested() {
+            // An object or an array given for a requested key
+            if (_depth == element_depth && _slot != npos) {
+                _status = sax_status::wrong_type;
+                return false;
+            }
+            ++_depth;
+            return true;
+        }
+
+        public:
+        extract_sax(Sink& sink, const key_schema<Ts...>& schema) : _schema(schema), _sink(sink) {}
+        extract_sax(Sink& sink, const argument<Ts>&... args) : _schema(args...), _sink(sink) {}
+
+        sax_status status() const { return _status; }
+
+        // Whether the next string value is stored, so streaming parsers can skip buffering it
+        bool wants_value() const { return _depth == element_depth && _slot != npos; }
+
+        // A key too long to be buffered can't be one of ours
+        bool skip_key() {
+            if (_depth == element_depth) _slot = npos;
+            return true;
+        }
+
+        bool null() { return value(std::nullptr_t()); }
+        bool boolean(bool val) { return value(val); }
+        bool number_integer(json::number_integer_t val) { return value(val); }
+        bool number_unsigned(json::number_unsigned_t val) { return value(val); }
+        bool number_float(json::number_float_t val, std::string_view) { return value(val); }
+        bool string(std::string_view val) { return value(val); }
+        bool binary(json::binary_t&) { return value(std::nullptr_t()); }
+
+        bool start_object(std::size_t) {
+            if (!nested()) return false;
+            if (_depth == element_depth) {
+                _values = std::tuple<Ts...>();
+                _seen = 0;
+            }
+            return true;
+        }
+
+        bool key(std::string_view val) {
+            if (_depth != element_depth) return true;
+
+            _slot = _schema.find(val);
+            return true;
+        }
+
+        bool end_object() {
+            if (_depth-- != element_depth) return true;
+
+            if (_seen != all_seen) {
+                _status = sax_status::missing_key;
+                return false;
+            }
+            if (!_sink(std::as_const(_values))) {
+                _status = sax_status::stopped;
+                return false;
+            }
+            return true;
+        }
+
+        bool start_array(std::size_t) { return nested(); }
+        bool end_array() { --_depth; return true; }
+
+        bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception&) {
+            _status = sax_status::syntax_error;
+            return false;
+        }
+    };
+
+    // Push-style JSON tokenizer emitting the same events as json::sax_parse.
+    // Input is fed in chunks of any size and all state is kept between feed() calls, so
+    // memory is bounded by TokenCapacity (longest key, number or requested string value)
+    // and the nesting depth, regardless of the size of the body.
+    // String values the handler doesn't want (see extract_sax::wants_value) aren't buffered.
+    template <class Handler, std::size_t TokenCapacity = 64>
+    class chunked_parser {
+        static constexpr std::size_t max_depth = 32;
+
+        enum class expect : uint8_t { value, value_or_end, key, key_or_end, colon, comma_or_end, done };
+        enum class token : uint8_t { none, string, escape, unicode, surrogate_escape, surrogate_u, number, literal };
+        // Where a number is in the JSON number grammar, -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+        enum class number_part : uint8_t { sign, zero, integer, dot, fraction, exp, exp_sign, exponent };
+
+        Handler& _handler;
+        sax_status _status = sax_status::ok;
+        expect _expect = expect::value;
+        token _token = token::none;
+
+        uint32_t _objects = 0; // bit per nesting level, set for objects
+        std::size_t _depth = 0;
+
+        char _buffer[TokenCapacity + 1];
+        std::size_t _length = 0;
+        bool _is_key = false;
+        bool _buffering = false;
+        bool _overflow = false;
+
+        number_part _number = number_part::integer;
+
+        const char* _literal = nullptr; // remaining characters of true/false/null
+        char _literal_kind = 0;
+
+        uint32_t _codepoint = 0;
+        uint32_t _high_surrogate = 0;
+        uint8_t _hex_digits = 0;
+
+        static bool is_space(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+        static bool is_digit(char c) { return c >= '0' && c <= '9'; }
+        static bool is_number_char(char c) {
+            return is_digit(c) || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+        }
+        static int hex_value(char c) {
+            if (c >= '0' && c <= '9') return c - '0';
+            if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+            if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+            return -1;
+        }
+
+        // Whether `c` can follow the number scanned so far; numbers nlohmann rejects are rejected here too
+        bool number_char(char c) {
+            bool exp = c == 'e' || c == 'E';
+            switch (_number) {
+                case number_part::sign:
+                    if (!is_digit(c)) return false;
+                    _number = c == '0' ? number_part::zero : number_part::integer;
+                    return true;
+                case number_part::zero:
+                case number_part::integer:
+                case number_part::fraction:
+                    if (is_digit(c) && _number != number_part::zero) return true;
+                    if (c == '.' && _number != number_part::fraction) _number = number_part::dot;
+                    else if (exp) _number = number_part::exp;
+                    else return false;
+                    return true;
+                case number_part::dot:
+                    if (!is_digit(c)) return false;
+                    _number = number_part::fraction;
+                    return true;
+                case number_part::exp:
+                    if (c == '+' || c == '-') _number = number_part::exp_sign;
+                    else if (is_digit(c)) _number = number_part::exponent;
+                    else return false;
+                    return true;
+                case number_part::exp_sign:
+                    if (!is_digit(c)) return false;
+                    _number = number_part::exponent;
+                    return true;
+                case number_part::exponent:
+                    return is_digit(c);
+            }
+            return false;
+        }
+
+        bool number_complete() const {
+            return _number == number_part::zero || _number == number_part::integer ||
+                _number == number_part::fraction || _number == number_part::exponent;
+        }
+
+        bool in_object() const { return _depth > 0 && (_objects >> (_depth - 1)) & 1; }
+
+        bool fail(sax_status status) {
+            _status = status;
+            return false;
+        }
+
+        bool emitted(bool handler_result) {
+            if (handler_result) return true;
+            _status = _handler.status() == sax_status::ok ? sax_status::stopped : _handler.status();
+            return false;
+        }
+
+        void append(char c) {
+            if (!_buffering) return;
+            if (_length == TokenCapacity) {
+                _overflow = true;
+                return;
+            }
+            _buffer[_length++] = c;
+        }
+
+        void append_utf8(uint32_t cp) {
+            if (cp < 0x80) {
+                append(static_cast<char>(cp));
+            } else if (cp < 0x800) {
+                append(static_cast<char>(0xC0 | (cp >> 6)));
+                append(static_cast<char>(0x80 | (cp & 0x3F)));
+            } else if (cp < 0x10000) {
+                append(static_cast<char>(0xE0 | (cp >> 12)));
+                append(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+                append(static_cast<char>(0x80 | (cp & 0x3F)));
+            } else {
+                append(static_cast<char>(0xF0 | (cp >> 18)));
+                append(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+                append(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+                append(static_cast<char>(0x80 | (cp & 0x3F)));
+            }
+        }
+
+        void begin_token(token t, bool buffering) {
+            _token = t;
+            _length = 0;
+            _overflow = false;
+            _buffering = buffering;
+        }
+
+        bool value_done() {
+            _token = token::none;
+            _expect = _depth == 0 ? expect::done : expect::comma_or_end;
+            return true;
+        }
+
+        bool open(bool object) {
+            if (_depth == max_depth) return fail(sax_status::too_large);
+
+            if (object) _objects |= (uint32_t(1) << _depth);
+            else _objects &= ~(uint32_t(1) << _depth);
+            ++_depth;
+
+            _expect = object ? expect::key_or_end : expect::value_or_end;
+            return emitted(object ? _handler.start_object(std::size_t(-1)) : _handler.start_array(std::size_t(-1)));
+        }
+
+        bool close(bool object) {
+            if (_depth == 0 || in_object() != object) return fail(sax_status::syntax_error);
+
+            --_depth;
+            if (!emitted(object ? _handler.end_object() : _handler.end_array())) return false;
+            return value_done();
+        }
+
+        bool end_string() {
+            std::string_view text(_buffer, _length);
+            if (_is_key) {
+                _token = token::none;
+                _expect = expect::colon;
+                return emitted(_overflow ? _handler.skip_key() : _handler.key(text));
+            }
+
+            if (_overflow) return fail(sax_status::too_large);
+            return emitted(_handler.string(text)) && value_done();
+        }
+
+        bool end_number() {
+            if (!number_complete()) return fail(sax_status::syntax_error);
+            if (_overflow) return fail(sax_status::too_large);
+            _buffer[_length] = '\0';
+
+            const char* first = _buffer;
+            const char* last = _buffer + _length;
+            bool integral = std::none_of(first, last, [](char c) {
+                return c == '.' || c == 'e' || c == 'E';
+            });
+
+            if (integral && _buffer[0] == '-') {
+                json::number_integer_t value = 0;
+                auto [end, ec] = std::from_chars(first, last, value);
+                if (end == last && ec == std::errc()) {
+                    return emitted(_handler.number_integer(value)) && value_done();
+                }
+            } else if (integral) {
+                json::number_unsigned_t value = 0;
+                auto [end, ec] = std::from_chars(first, last, value);
+                if (end == last && ec == std::errc()) {
+                    return emitted(_handler.number_unsigned(value)) && value_done();
+                }
+            }
+
+            // Fractions, exponents and integers out of range. Floating point from_chars
+            // isn't available in every toolchain we build with.
+            char* end = nullptr;
+            auto value = std::strtod(_buffer, &end);
+            if (end != _buffer + _length) return fail(sax_status::syntax_error);
+            return emitted(_handler.number_float(value, std::string_view(_buffer, _length))) && value_done();
+        }
+
+        bool end_literal() {
+            switch (_literal_kind) {
+                case 't': return emitted(_handler.boolean(true)) && value_done();
+                case 'f': return emitted(_handler.boolean(false)) && value_done();
+                default: return emitted(_handler.null()) && value_done();
+            }
+        }
+
+        bool end_unicode() {
+            uint32_t cp = _codepoint;
+            if (_high_surrogate != 0) {
+                if (cp < 0xDC00 || cp > 0xDFFF) return fail(sax_status::syntax_error);
+                cp = 0x10000 + ((_high_surrogate - 0xD800) << 10) + (cp - 0xDC00);
+                _high_surrogate = 0;
+            } else if (cp >= 0xD800 && cp <= 0xDBFF) {
+                _high_surrogate = cp;
+                _token = token::surrogate_escape;
+                return true;
+            } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                return fail(sax_status::syntax_error);
+            }
+
+            append_utf8(cp);
+            _token = token::string;
+            return true;
+        }
+
+        bool begin_value(char c) {
+            switch (c) {
+                case '{': return open(true);
+                case '[': return open(false);
+                case '"':
+                    _is_key = false;
+                    begin_token(token::string, _handler.wants_value());
+                    return true;
+                case 't': _literal = "rue"; break;
+                case 'f': _literal = "alse"; break;
+                case 'n': _literal = "ull"; break;
+                default:
+                    if (c != '-' && !is_digit(c)) return fail(sax_status::syntax_error);
+                    begin_token(token::number, true);
+                    _number = c == '-' ? number_part::sign : c == '0' ? number_part::zero : number_part::integer;
+                    append(c);
+                    return true;
+            }
+            _literal_kind = c;
+            _token = token::literal;
+            return true;
+        }
+
+        bool structural(char c) {
+            if (is_space(c)) return true;
+
+            switch (_expect) {
+                case expect::done:
+                    return fail(sax_status::syntax_error);
+                case expect::colon:
+                    if (c != ':') return fail(sax_status::syntax_error);
+                    _expect = expect::value;
+                    return true;
+                case expect::comma_or_end:
+                    if (c == ',') {
+                        _expect = in_object() ? expect::key : expect::value;
+                        return true;
+                    }
+                    if (c == '}' || c == ']') return close(c == '}');
+                    return fail(sax_status::syntax_error);
+                case expect::key_or_end:
+                    if (c == '}') return close(true);
+                    // fall through
+                case expect::key:
+                    if (c != '"') return fail(sax_status::syntax_error);
+                    _is_key = true;
+                    begin_token(token::string, true);
+                    return true;
+                case expect::value_or_end:
+                    if (c == ']') return close(false);
+                    // fall through
+                case expect::value:
+                    return begin_value(c);
+            }
+            return fail(sax_status::syntax_error);
+        }
+
+        bool consume(char c) {
+            switch (_token) {
+                case token::none:
+                    return structural(c);
+
+                case token::string:
+                    if (c == '"') return end_string();
+                    if (c == '\\') {
+                        _token = token::escape;
+                        return true;
+                    }
+                    if (static_cast<unsigned char>(c) < 0x20) return fail(sax_status::syntax_error);
+                    append(c);
+                    return true;
+
+                case token::escape:
+                    _token = token::string;
+                    switch (c) {
+                        case '"': append('"'); return true;
+                        case '\\': append('\\'); return true;
+                        case '/': append('/'); return true;
+                        case 'b': append('\b'); return true;
+                        case 'f': append('\f'); return true;
+                        case 'n': append('\n'); return true;
+                        case 'r': append('\r'); return true;
+                        case 't': append('\t'); return true;
+                        case 'u':
+                            _token = token::unicode;
+                            _codepoint = 0;
+                            _hex_digits = 0;
+                            return true;
+                        default: return fail(sax_status::syntax_error);
+                    }
+
+                case token::surrogate_escape:
+                    if (c != '\\') return fail(sax_status::syntax_error);
+                    _token = token::surrogate_u;
+                    return true;
+
+                case token::surrogate_u:
+                    if (c != 'u') return fail(sax_status::syntax_error);
+                    _token = token::unicode;
+                    _codepoint = 0;
+                    _hex_digits = 0;
+                    return true;
+
+                case token::unicode: {
+                    int digit = hex_value(c);
+                    if (digit < 0) return fail(sax_status::syntax_error);
+                    _codepoint = (_codepoint << 4) | static_cast<uint32_t>(digit);
+                    if (++_hex_digits < 4) return true;
+                    return end_unicode();
+                }
+
+                case token::number:
+                    if (is_number_char(c)) {
+                        if (!number_char(c)) return fail(sax_status::syntax_error);
+                        append(c);
+                        return true;
+                    }
+                    return end_number() && structural(c);
+
+                case token::literal:
+                    if (c != *_literal) return fail(sax_status::syntax_error);
+                    if (*++_literal == '\0') return end_literal();
+                    return true;
+            }
+            return fail(sax_status::syntax_error);
+        }
+
+        public:
+        explicit chunked_parser(Handler& handler) : _handler(handler) {}
+
+        chunked_parser(const chunked_parser&) = delete;
+        chunked_parser& operator=(const chunked_parser&) = delete;
+
+        sax_status status() const { return _status; }
+        bool done() const { return _expect == expect::done && _token == token::none; }
+
+        // Consumes the next chunk of the body. Returns `ok` while more input is welcome.
+        sax_status feed(const char* data, std::size_t length) {
+            for (std::size_t i = 0; i < length && _status == sax_status::ok; i++) {
+                consume(data[i]);
+            }
+            return _status;
+        }
+
+        // Signals the end of the body. A top level number is only complete at this point.
+        sax_status finish() {
+            if (_status != sax_status::ok) return _status;
+            if (_token == token::number && !end_number()) return _status;
+            if (!done()) _status = sax_status::truncated;
+            return _status;
+        }
+    };
+
+    // Walks `text` with an extract_sax handler, calling `sink` for every element.
+    // Returns the final status; `stopped` means the sink asked to end early.
+    template <class Input, class Sink, class... Ts>
+    sax_status for_each_element(Input&& text, Sink&& sink, const key_schema<Ts...>& schema) {
+        extract_sax<std::remove_reference_t<Sink>, Ts...> handler(sink, schema);
+        json::sax_parse(std::forward<Input>(text), &handler);
+        return handler.status();
+    }
+
+    template <class Input, class Sink, class... Ts>
+    sax_status for_each_element(Input&& text, Sink&& sink, const argument<Ts>&... args) {
+        return for_each_element(std::forward<Input>(text), std::forward<Sink>(sink), key_schema<Ts...>(args...));
+    }
+
+    inline error_code to_error(sax_status status) {
+        switch (status) {
+            case sax_status::ok:
+            case sax_status::stopped: return error_code::none;
+            case sax_status::syntax_error: return error_code::malformed_body;
+            case sax_status::wrong_type: return error_code::wrong_type;
+            case sax_status::missing_key: return error_code::missing_key;
+            case sax_status::truncated: return error_code::truncated_body;
+            case sax_status::too_large: return error_code::too_large;
+        }
+        return error_code::malformed_body;
+    }
+
+#if NEXT_STOP_EXCEPTIONS
+    inline void throw_on_error(sax_status status) {
+        auto error = to_error(status);
+        if (error != error_code::none) throw std::invalid_argument(std::string("next_stop: ") + describe(error));
     }
 
     template <class Input>
     void parse(Input&& text) {
-        auto data = json::parse(text);
-        for (auto it : data) {
-            auto tup1 = extract_key(
-                std::move(it), 
-                argument<std::string>("direction"),
-                argument<int64_t>("arriving_at_timestamp")
-            );
-        }
+        throw_on_error(for_each_element(
+            std::forward<Input>(text),
+            [](const std::tuple<std::string, int64_t>&) { return true; },
+            argument<std::string>("direction"),
+            argument<int64_t>("arriving_at_timestamp")
+        ));
     }
 
     template <class Input, class... Ts>
     std::vector<std::tuple<Ts...>> parse(Input&& text, const argument<Ts>&&... args) {
         auto result = std::vector<std::tuple<Ts...>>();
-        auto data = json::parse(text);
-        for (auto it : data) {
-            result.push_back(extract_key(
-                std::move(it), 
-                std::move(args)...
-            ));
-        }
+        throw_on_error(for_each_element(
+            std::forward<Input>(text),
+            [&result](const std::tuple<Ts...>& values) {
+                result.push_back(values);
+                return true;
+            },
+            args...
+        ));
         return result;
     }
 
+#endif
+
+    // Owns an extract_sax handler and a chunked_parser over it, for bodies read piecewise.
+    template <class Sink, class... Ts>
+    class element_stream {
+        Sink _sink;
+        extract_sax<Sink, Ts...> _handler;
+        chunked_parser<extract_sax<Sink, Ts...>> _parser;
+
+        public:
+        element_stream(Sink sink, const key_schema<Ts...>& schema) :
+            _sink(std::move(sink)), _handler(_sink, schema), _parser(_handler) {}
+        element_stream(Sink sink, const argument<Ts>&... args) :
+            _sink(std::move(sink)), _handler(_sink, args...), _parser(_handler) {}
+
+        element_stream(const element_stream&) = delete;
+        element_stream& operator=(const element_stream&) = delete;
+
+        const Sink& sink() const { return _sink; }
+
+        sax_status feed(const char* data, std::size_t length) { return _parser.feed(data, length); }
+        sax_status finish() { return _parser.finish(); }
+    };
+
+    struct minutes_sink {
+        timestamp_t sample_ts;
+        std::vector<int>& minutes;
+
+        bool operator()(const std::tuple<int64_t>& tup) const {
+            minutes.push_back(minutes_until(std::get<0>(tup), sample_ts));
+            return true;
+        }
+    };
+
+    // Writes minutes straight into caller provided storage, stopping the parse once it is full
+    template <class OutputIt>
+    struct minutes_writer {
+        timestamp_t sample_ts;
+        OutputIt out;
+        std::size_t capacity;
+        std::size_t count = 0;
+
+        bool operator()(const std::tuple<int64_t>& tup) {
+            *out = minutes_until(std::get<0>(tup), sample_ts);
+            ++out;
+            return ++count < capacity;
+        }
+    };
+
+    // Writes the arrival timestamps themselves, for callers that count down locally
+    template <class OutputIt>
+    struct arrivals_writer {
+        OutputIt out;
+        std::size_t capacity;
+        std::size_t count = 0;
+
+        bool operator()(const std::tuple<int64_t>& tup) {
+            *out = std::get<0>(tup);
+            ++out;
+            return ++count < capacity;
+        }
+    };
+
+    using next_minutes_stream = element_stream<minutes_sink, int64_t>;
+
+    template <class OutputIt>
+    using next_minutes_writer_stream = element_stream<minutes_writer<OutputIt>, int64_t>;
+
+    template <class OutputIt>
+    using arrivals_writer_stream = element_stream<arrivals_writer<OutputIt>, int64_t>;
+
+    // Incremental counterpart of next_minutes: feed() the body as it is received, then finish().
+    inline next_minutes_stream make_next_minutes_stream(timestamp_t sample_ts, std::vector<int>& minutes) {
+        return next_minutes_stream(minutes_sink{sample_ts, minutes}, arriving_at_schema);
+    }
+
+    // Allocation free variant writing at most `capacity` minutes to `out`; sink().count holds the result.
+    template <class OutputIt>
+    next_minutes_writer_stream<OutputIt> make_next_minutes_stream(timestamp_t sample_ts, OutputIt out, std::size_t capacity) {
+        return next_minutes_writer_stream<OutputIt>(
+            minutes_writer<OutputIt>{sample_ts, out, capacity},
+            arriving_at_schema
+        );
+    }
+
+#if NEXT_STOP_EXCEPTIONS
     template <class Input>
     std::vector<int> next_minutes(const std::string& timestamp, Input&& body) {
-        // TODO: If timestamp is null or empty
-        timestamp_t sample_ts = parse_timestamp(timestamp);
-
-        auto parsed = parse(std::move(body), argument<int64_t>("arriving_at_timestamp"));
+        auto sample_ts = try_parse_timestamp(timestamp);
+        if (!sample_ts) throw std::invalid_argument("next_stop: bad header");
 
-        auto results = std::vector<int>(parsed.size());
-        std::transform(parsed.begin(), parsed.end(), results.begin(), [&sample_ts](const decltype(parsed[0])& tup) {
-            return (std::get<0>(tup) - sample_ts) / 60;
-        });
+        auto results = std::vector<int>();
+        throw_on_error(for_each_element(
+            std::forward<Input>(body),
+            minutes_sink{sample_ts.value(), results},
+            arriving_at_schema
+        ));
         return results;
     }
+#endif
+
+    // Writes at most `capacity` minutes to `out` and returns how many were written, or why none
+    // could be. Runs the chunked parser over the whole body in one go: no allocations, no throws.
+    template <class Input, class OutputIt>
+    result<std::size_t> try_next_minutes(std::string_view timestamp, const Input& body, OutputIt out,
+                                         std::size_t capacity) {
+        auto sample_ts = try_parse_timestamp(timestamp);
+        if (!sample_ts) return sample_ts.error();
+        if (capacity == 0) return std::size_t(0);
+
+        auto stream = make_next_minutes_stream(sample_ts.value(), out, capacity);
+        auto text = body_view(body);
+        stream.feed(text.data(), text.size());
+
+        auto error = to_error(stream.finish());
+        if (error != error_code::none) return error;
+        return stream.sink().count;
+    }
+
+    // try_next_minutes, with 0 standing for any error
+    template <class Input, class OutputIt>
+    std::size_t next_minutes(const char* timestamp, const Input& body, OutputIt out, std::size_t capacity) {
+        return try_next_minutes(timestamp, body, out, capacity).value_or(0);
+    }
+
+    enum class order { sorted, unsorted };
+
+    // Keeps the K smallest elements, by their first tuple field, that pass `predicate`.
+    // For sorted input the walk stops as soon as K matches were seen. Otherwise the output range
+    // is used as a bounded max-heap, so the earliest K are kept whatever the input order is.
+    template <class RandomIt, class Predicate>
+    struct top_k_sink {
+        RandomIt first;
+        std::size_t k;
+        Predicate predicate;
+        order input_order;
+        std::size_t count = 0;
+
+        static bool earlier(const typename std::iterator_traits<RandomIt>::value_type& lhs,
+                            const typename std::iterator_traits<RandomIt>::value_type& rhs) {
+            return std::get<0>(lhs) < std::get<0>(rhs);
+        }
+
+        template <class Tuple>
+        bool operator()(const Tuple& element) {
+            if (!predicate(element)) return true;
+
+            if (input_order == order::sorted) {
+                first[count] = element;
+                return ++count < k;
+            }
+
+            if (count < k) {
+                first[count++] = element;
+                std::push_heap(first, first + count, earlier);
+            } else if (std::get<0>(element) < std::get<0>(first[0])) {
+                std::pop_heap(first, first + k, earlier);
+                first[k - 1] = element;
+                std::push_heap(first, first + k, earlier);
+            }
+            return true;
+        }
+
+        // Leaves [first, first + count) in ascending order
+        void finish() {
+            if (input_order == order::unsorted) std::sort_heap(first, first + count, earlier);
+        }
+    };
+
+    // Writes the earliest `k` elements passing `predicate` to [first, first + k) in ascending
+    // order of the first requested key, and returns how many were found (0 if the body is malformed).
+    // Work and memory are bounded by `k`: nothing beyond the output range is stored.
+    template <class Input, class RandomIt, class Predicate, class... Ts>
+    std::size_t top_k(const Input& body, RandomIt first, std::size_t k, order input_order,
+                      Predicate predicate, const key_schema<Ts...>& schema) {
+        if (k == 0) return 0;
+
+        element_stream<top_k_sink<RandomIt, Predicate>, Ts...> stream(
+            top_k_sink<RandomIt, Predicate>{first, k, std::move(predicate), input_order}, schema);
+        auto text = body_view(body);
+        stream.feed(text.data(), text.size());
+
+        auto status = stream.finish();
+        if (status != sax_status::ok && status != sax_status::stopped) return 0;
+
+        auto sink = stream.sink();
+        sink.finish();
+        return sink.count;
+    }
+
+    template <class Input, class RandomIt, class Predicate, class... Ts>
+    std::size_t top_k(const Input& body, RandomIt first, std::size_t k, order input_order,
+                      Predicate predicate, const argument<Ts>&... args) {
+        return top_k(body, first, k, input_order, std::move(predicate), key_schema<Ts...>(args...));
+    }
+
+    // (arriving_at_timestamp, direction) as extracted for top-K arrival queries
+    using arrival_t = std::tuple<timestamp_t, std::string>;
+
+    struct future_only {
+        timestamp_t sample_ts;
+        bool operator()(const arrival_t& arrival) const { return std::get<0>(arrival) >= sample_ts; }
+    };
+
+    struct direction_is {
+        std::string_view direction;
+        bool operator()(const arrival_t& arrival) const { return std::get<1>(arrival) == direction; }
+    };
+
+    template <class... Predicates>
+    auto match_all(Predicates... predicates) {
+        return [=](const arrival_t& arrival) { return (predicates(arrival) && ...); };
+    }
+
+    // Minutes until the earliest K arrivals passing `predicate`, written to `out`.
+    // Returns how many were written, 0 when the timestamp is malformed.
+    template <std::size_t K, class Input, class OutputIt, class Predicate>
+    std::size_t next_minutes_top_k(const char* timestamp, const Input& body, OutputIt out,
+                                   Predicate predicate, order input_order = order::sorted) {
+        auto parsed = try_parse_timestamp(timestamp);
+        if (!parsed) return 0;
+        timestamp_t sample_ts = parsed.value();
+
+        std::array<arrival_t, K> arrivals;
+        auto found = top_k(body, arrivals.begin(), K, input_order, std::move(predicate), arrival_schema);
+
+        for (std::size_t i = 0; i < found; i++) {
+            *out = minutes_until(std::get<0>(arrivals[i]), sample_ts);
+            ++out;
+        }
+        return found;
+    }
+
+    // Compact binary alternative to the JSON body, served when the client sends
+    // `Accept: application/x-next-stop`. All fields are fixed-width little-endian:
+    //
+    //   header (16 bytes): 'N' 'S' | version u8 | record size u8 | count u32 | sample timestamp i64
+    //   record (20 bytes): arriving_at i64 | leaving_at i64 | direction_id u16 | line_id u16
+    //
+    // direction_id follows config::Direction (0 unknown, 1 south, 2 north); line_id packs up to
+    // two ASCII characters of the route id, first character in the low byte.
+    namespace wire {
+
+    constexpr const char* content_type = "application/x-next-stop";
+    constexpr uint8_t version = 1;
+    constexpr std::size_t header_size = 16;
+    constexpr std::size_t record_size = 20;
+
+    template <class T>
+    T read_le(const uint8_t* p) {
+        using U = std::make_unsigned_t<T>;
+        U value = 0;
+        for (std::size_t i = 0; i < sizeof(T); i++) value |= static_cast<U>(p[i]) << (8 * i);
+        return static_cast<T>(value);
+    }
+
+    struct arrival_record {
+        timestamp_t arriving_at;
+        timestamp_t leaving_at;
+        uint16_t direction_id;
+        uint16_t line_id;
+    };
+
+    // Zero-copy view over an encoded body; records are decoded on access.
+    class arrivals_view {
+        const uint8_t* _records = nullptr;
+        std::size_t _count = 0;
+        std::size_t _stride = record_size;
+        timestamp_t _sample_ts = 0;
+
+        public:
+        class iterator {
+            const uint8_t* _p;
+            std::size_t _stride;
+
+            public:
+            iterator(const uint8_t* p, std::size_t stride) : _p(p), _stride(stride) {}
+
+            arrival_record operator*() const {
+                return {read_le<int64_t>(_p), read_le<int64_t>(_p + 8), read_le<uint16_t>(_p + 16),
+                        read_le<uint16_t>(_p + 18)};
+            }
+            iterator& operator++() {
+                _p += _stride;
+                return *this;
+            }
+            bool operator==(const iterator& rhs) const { return _p == rhs._p; }
+            bool operator!=(const iterator& rhs) const { return !(*this == rhs); }
+        };
+
+        arrivals_view() = default;
+
+        // Validates the header. With `partial`, a body cut short (e.g. read into a buffer smaller
+        // than the response) yields a view over the complete records it holds.
+        static result<arrivals_view> decode(const uint8_t* data, std::size_t length, bool partial = false) {
+            if (length < header_size) return error_code::truncated_body;
+            if (data[0] != 'N' || data[1] != 'S' || data[2] != version || data[3] < record_size) {
+                return error_code::malformed_body;
+            }
+
+            arrivals_view view;
+            view._stride = data[3];
+            view._count = read_le<uint32_t>(data + 4);
+            view._sample_ts = read_le<int64_t>(data + 8);
+            view._records = data + header_size;
+
+            std::size_t available = (length - header_size) / view._stride;
+            if (available < view._count) {
+                if (!partial) return error_code::truncated_body;
+                view._count = available;
+            }
+            return view;
+        }
+
+        timestamp_t sample_ts() const { return _sample_ts; }
+        std::size_t size() const { return _count; }
+        bool empty() const { return _count == 0; }
+
+        arrival_record operator[](std::size_t i) const { return *iterator(_records + i * _stride, _stride); }
+        iterator begin() const { return iterator(_records, _stride); }
+        iterator end() const { return iterator(_records + _count * _stride, _stride); }
+    };
+
+    // Minutes until each arrival, relative to the sample timestamp carried in the header
+    template <class OutputIt>
+    std::size_t next_minutes(const arrivals_view& arrivals, OutputIt out, std::size_t capacity) {
+        std::size_t count = 0;
+        for (auto it = arrivals.begin(); it != arrivals.end() && count < capacity; ++it, ++count) {
+            *out = minutes_until((*it).arriving_at, arrivals.sample_ts());
+            ++out;
+        }
+        return count;
+    }
+
+    // Arrival timestamps as sent, for callers that count down locally
+    template <class OutputIt>
+    std::size_t next_arrivals(const arrivals_view& arrivals, OutputIt out, std::size_t capacity) {
+        std::size_t count = 0;
+        for (auto it = arrivals.begin(); it != arrivals.end() && count < capacity; ++it, ++count) {
+            *out = (*it).arriving_at;
+            ++out;
+        }
+        return count;
+    }
+
+    } // namespace wire
 }
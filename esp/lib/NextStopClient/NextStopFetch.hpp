@@ -0,0 +1,467 @@
+#pragma once
+
+#include <NextStopClient.hpp>
+
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <string_view>
+
+namespace next_stop {
+
+    // Preferred binary arrivals format; servers that don't know it answer with JSON
+    constexpr const char* accept = "application/x-next-stop, application/json;q=0.5";
+
+    struct url_parts {
+        std::string_view host;
+        uint16_t port = 80;
+        std::string_view path;
+    };
+
+    // http://host[:port][/path], the only kind of URL the firmware fetches
+    inline result<url_parts> try_parse_url(std::string_view url) {
+        constexpr std::string_view scheme = "http://";
+        if (url.substr(0, scheme.size()) != scheme) return error_code::bad_url;
+        url.remove_prefix(scheme.size());
+
+        url_parts parts;
+        auto slash = url.find('/');
+        parts.path = slash == std::string_view::npos ? std::string_view("/") : url.substr(slash);
+
+        auto authority = url.substr(0, slash);
+        auto colon = authority.find(':');
+        parts.host = authority.substr(0, colon);
+        if (parts.host.empty()) return error_code::bad_url;
+
+        if (colon != std::string_view::npos) {
+            auto port = authority.substr(colon + 1);
+            unsigned value = 0;
+            auto [end, ec] = std::from_chars(port.data(), port.data() + port.size(), value);
+            if (port.empty() || ec != std::errc() || end != port.data() + port.size() || value == 0 || value > 65535) {
+                return error_code::bad_url;
+            }
+            parts.port = static_cast<uint16_t>(value);
+        }
+        return parts;
+    }
+
+    inline bool equals_ignore_case(std::string_view a, std::string_view b) {
+        if (a.size() != b.size()) return false;
+        for (std::size_t i = 0; i < a.size(); i++) {
+            char x = a[i], y = b[i];
+            if (x >= 'A' && x <= 'Z') x += 'a' - 'A';
+            if (y >= 'A' && y <= 'Z') y += 'a' - 'A';
+            if (x != y) return false;
+        }
+        return true;
+    }
+
+    // Fetches the arrivals step by step: start() a request, then call step() from the main loop.
+    // Reading the response never blocks, each step reads and parses at most BodyChunk bytes of what
+    // has already arrived, so the display keeps animating while it comes in. Opening a connection
+    // and sending the request do block: WiFiClient has no non-blocking connect, so that step waits
+    // until connected or the client's own timeout (WiFiClient::setTimeout), and a request that
+    // fits the socket's send buffer is written at once. Reusing a kept-alive connection skips the
+    // connect. Arrival timestamps are written straight into the caller's storage, together with
+    // the server time they are relative to in sample_ts(); nothing is allocated.
+    //
+    // With a keep_alive_ms above 0 the connection is kept open between fetches when the server
+    // agrees to, and reused for up to keep_alive_ms of idling. A reused connection found closed
+    // before the response started is replaced by a new one once, within the same fetch.
+    //
+    // Socket is anything with this subset of WiFiClient, so the firmware passes a WiFiClient
+    // and the native tests a fake:
+    //   int connect(const char* host, uint16_t port)       nonzero once connected; may block
+    //   size_t write(const uint8_t* data, size_t length)   may write less than asked
+    //   int available()
+    //   int read(uint8_t* buffer, size_t length)
+    //   uint8_t connected()
+    //   void stop()
+    template <class Socket, std::size_t BodyChunk = 128, std::size_t BinaryRecords = 8>
+    class fetcher {
+        public:
+        enum class status { idle, busy, done, not_modified, failed };
+
+        private:
+        enum class stage { connect, send, headers, body, drain };
+
+        Socket& _socket;
+        unsigned long _timeout_ms;
+        unsigned long _keep_alive_ms;
+
+        char _host[64] = "";
+        uint16_t _port = 80;
+        char _path[128] = "";
+        // Validator of the last response we used; the server answers 304 while its snapshot is unchanged
+        char _etag[64] = "";
+
+        char _request[384];
+        std::size_t _request_length = 0;
+        std::size_t _sent = 0;
+
+        status _status = status::idle;
+        stage _stage = stage::connect;
+        error_code _error = error_code::none;
+        unsigned long _started = 0;
+        unsigned long _now = 0;
+
+        // An open connection left by the last fetch, and since when it idles
+        bool _open = false;
+        unsigned long _idle_since = 0;
+        // Whether this fetch runs on a reused connection, and what it has read from it
+        bool _reused = false;
+        std::size_t _received = 0;
+        unsigned long _handshakes = 0;
+        unsigned long _requests = 0;
+
+        timestamp_t* _out = nullptr;
+        std::size_t _capacity = 0;
+        std::size_t _count = 0;
+
+        // Response headers, read a line at a time. Longer lines keep their start.
+        char _line[128];
+        std::size_t _line_length = 0;
+        bool _status_line = false;
+        int _http_status = 0;
+        long _remaining = -1;  // Content-Length left to read, -1 when unknown
+        bool _persistent = false;  // the server keeps the connection open after this response
+        bool _binary = false;
+        result<timestamp_t> _sample_ts = error_code::bad_header;
+        result<timestamp_t> _feed_ts = error_code::bad_header;
+        char _response_etag[64];
+
+        std::optional<arrivals_writer_stream<timestamp_t*>> _json;
+        // Only the first records are kept, the view covers the complete ones that fit
+        uint8_t _records[wire::header_size + BinaryRecords * wire::record_size];
+        std::size_t _records_length = 0;
+
+        public:
+        fetcher(Socket& socket, unsigned long timeout_ms, unsigned long keep_alive_ms = 0) :
+            _socket(socket), _timeout_ms(timeout_ms), _keep_alive_ms(keep_alive_ms) {}
+
+        fetcher(const fetcher&) = delete;
+        fetcher& operator=(const fetcher&) = delete;
+
+        // Returns false, leaving the fetcher unconfigured, when the URL can't be used
+        bool set_url(std::string_view url) {
+            abort();
+            _host[0] = _path[0] = _etag[0] = '\0';
+
+            auto parts = try_parse_url(url);
+            if (!parts || !copy(parts.value().host, _host) || !copy(parts.value().path, _path)) {
+                _host[0] = _path[0] = '\0';
+                return false;
+            }
+            _port = parts.value().port;
+            return true;
+        }
+
+        // Begins fetching up to `capacity` arrival timestamps into `out`. Returns false if a fetch
+        // is already running; a fetch that can't start fails on the next step().
+        bool start(timestamp_t* out, std::size_t capacity, unsigned long now) {
+            if (_status == status::busy) return false;
+
+            _out = out;
+            _capacity = capacity;
+            _count = 0;
+            _error = error_code::none;
+            _started = now;
+            _status = status::busy;
+            _stage = stage::connect;
+
+            _line_length = 0;
+            _status_line = false;
+            _http_status = 0;
+            _remaining = -1;
+            _persistent = false;
+            _received = 0;
+            _binary = false;
+            _sample_ts = error_code::bad_header;
+            _feed_ts = error_code::bad_header;
+            _response_etag[0] = '\0';
+            _records_length = 0;
+            _sent = 0;
+
+            int length = -1;
+            if (_host[0] != '\0') {
+                char host[sizeof(_host) + 7];
+                std::snprintf(host, sizeof(host), _port == 80 ? "%s" : "%s:%u", _host, unsigned(_port));
+                length = std::snprintf(_request, sizeof(_request),
+                    // HTTP/1.0 keeps the server from using chunked transfer encoding, so the raw stream is the body
+                    // and a kept-alive response is always delimited by its Content-Length
+                    "GET %s HTTP/1.0\r\nHost: %s\r\nAccept: %s\r\n%s%s%sConnection: %s\r\n\r\n",
+                    _path, host, accept,
+                    _etag[0] ? "If-None-Match: " : "", _etag, _etag[0] ? "\r\n" : "",
+                    _keep_alive_ms > 0 ? "keep-alive" : "close");
+            }
+            if (length < 0 || std::size_t(length) >= sizeof(_request)) {
+                fail(error_code::bad_url);
+            } else if (capacity == 0) {
+                // Nothing goes on the wire, so a kept connection stays as it is
+                _status = status::done;
+            }
+            _request_length = length < 0 ? 0 : std::size_t(length);
+            return true;
+        }
+
+        // Advances the running fetch by one step. Returns busy while it runs and done, not_modified
+        // or failed exactly once, from the step it ends on; idle otherwise.
+        status step(unsigned long now) {
+            _now = now;
+            if (_status == status::busy) {
+                if (now - _started >= _timeout_ms) {
+                    // The result is known, only the connection can't be reused
+                    if (_stage == stage::drain) {
+                        _persistent = false;
+                        finish(status::done);
+                    } else {
+                        fail(error_code::timed_out);
+                    }
+                } else {
+                    advance();
+                }
+            }
+
+            status reported = _status;
+            if (reported != status::busy) _status = status::idle;
+            return reported;
+        }
+
+        // Drops a running fetch without reporting it, and closes the connection
+        void abort() {
+            if (_status == status::busy || _open) _socket.stop();
+            _open = false;
+            _json.reset();
+            _status = status::idle;
+        }
+
+        bool busy() const { return _status == status::busy; }
+        // Arrivals written by the last fetch that was done
+        std::size_t count() const { return _count; }
+        // Server time of the last response, 304s included; bad_header when it carried none
+        result<timestamp_t> sample_ts() const { return _sample_ts; }
+        // When the server's feed behind the last response was produced; bad_header when not sent
+        result<timestamp_t> feed_ts() const { return _feed_ts; }
+        // Why the last fetch failed
+        error_code error() const { return _error; }
+        // HTTP status of the last response, 0 when none was read
+        int http_status() const { return _http_status; }
+        // Connections opened and requests sent so far; with keep-alive, requests outnumber them
+        unsigned long handshakes() const { return _handshakes; }
+        unsigned long requests() const { return _requests; }
+
+        private:
+        template <std::size_t N>
+        static bool copy(std::string_view from, char (&to)[N]) {
+            if (from.size() >= N) return false;
+            std::memcpy(to, from.data(), from.size());
+            to[from.size()] = '\0';
+            return true;
+        }
+
+        void finish(status result) {
+            _open = result != status::failed && _persistent && _keep_alive_ms > 0;
+            if (_open) {
+                _idle_since = _now;
+            } else {
+                _socket.stop();
+            }
+            _json.reset();
+            _status = result;
+        }
+
+        void fail(error_code error) {
+            _error = error;
+            finish(status::failed);
+        }
+
+        // A kept connection the server closed meanwhile ends before the response starts; that is
+        // retried once on a new connection
+        void fail_or_reconnect(error_code error) {
+            if (!_reused || _received > 0) return fail(error);
+            _socket.stop();
+            _reused = false;
+            _sent = 0;
+            _stage = stage::connect;
+        }
+
+        void advance() {
+            switch (_stage) {
+                case stage::connect:
+                    _reused = _open && _now - _idle_since < _keep_alive_ms && _socket.connected();
+                    _open = false;
+                    if (!_reused) {
+                        _socket.stop();
+                        // The one blocking step: WiFiClient's connect waits until connected or its own
+                        // timeout, keep that short
+                        if (!_socket.connect(_host, _port)) return fail(error_code::connection_failed);
+                        _handshakes++;
+                    }
+                    _requests++;
+                    _stage = stage::send;
+                    break;
+
+                case stage::send:
+                    _sent += _socket.write(reinterpret_cast<const uint8_t*>(_request) + _sent, _request_length - _sent);
+                    if (_sent == _request_length) {
+                        _stage = stage::headers;
+                    } else if (!_socket.connected()) {
+                        fail_or_reconnect(error_code::connection_failed);
+                    }
+                    break;
+
+                case stage::headers:
+                case stage::body:
+                case stage::drain:
+                    receive();
+                    break;
+            }
+        }
+
+        void receive() {
+            int available = _socket.available();
+            if (available <= 0) {
+                if (!_socket.connected()) end_of_stream();
+                return;
+            }
+
+            uint8_t buffer[BodyChunk];
+            int read = _socket.read(buffer, std::min<std::size_t>(available, sizeof(buffer)));
+            if (read <= 0) return;
+            _received += read;
+
+            if (_stage == stage::drain) {
+                _remaining -= std::min<long>(read, _remaining);
+                if (_remaining == 0) finish(status::done);
+                return;
+            }
+
+            const char* data = reinterpret_cast<const char*>(buffer);
+            std::size_t length = read;
+            while (length > 0 && _status == status::busy && _stage == stage::headers) {
+                header_char(*data++);
+                length--;
+            }
+            if (length > 0 && _status == status::busy) body(data, length);
+        }
+
+        void end_of_stream() {
+            _persistent = false;
+            if (_stage == stage::headers) return fail_or_reconnect(error_code::truncated_body);
+            if (_stage == stage::drain) return finish(status::done);
+            // Closed before Content-Length bytes arrived
+            if (_remaining > 0) return fail(error_code::truncated_body);
+            finish_body();
+        }
+
+        void header_char(char c) {
+            if (c == '\r') return;
+            if (c != '\n') {
+                if (_line_length < sizeof(_line)) _line[_line_length++] = c;
+                return;
+            }
+
+            std::string_view line(_line, _line_length);
+            _line_length = 0;
+            if (!_status_line) return status_line(line);
+            if (line.empty()) return headers_done();
+
+            auto colon = line.find(':');
+            if (colon == std::string_view::npos) return;
+            auto name = line.substr(0, colon);
+            auto value = line.substr(colon + 1);
+            while (!value.empty() && value.front() == ' ') value.remove_prefix(1);
+            while (!value.empty() && value.back() == ' ') value.remove_suffix(1);
+
+            if (equals_ignore_case(name, "Content-Type")) {
+                _binary = value.substr(0, std::strlen(wire::content_type)) == wire::content_type;
+            } else if (equals_ignore_case(name, "Content-Length")) {
+                long length = -1;
+                auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), length);
+                _remaining = ec == std::errc() && length >= 0 ? length : -1;
+            } else if (equals_ignore_case(name, "Connection")) {
+                _persistent = equals_ignore_case(value, "keep-alive");
+            } else if (equals_ignore_case(name, "ETag")) {
+                if (!copy(value, _response_etag)) _response_etag[0] = '\0';
+            } else if (equals_ignore_case(name, "x-timestamp")) {
+                _sample_ts = try_parse_timestamp(value);
+            } else if (equals_ignore_case(name, "x-feed-timestamp")) {
+                _feed_ts = try_parse_timestamp(value);
+            }
+        }
+
+        // HTTP/1.1 200 OK
+        void status_line(std::string_view line) {
+            _status_line = true;
+            auto space = line.find(' ');
+            if (line.substr(0, 5) != "HTTP/" || space == std::string_view::npos) return fail(error_code::bad_status);
+
+            auto code = line.substr(space + 1, 3);
+            auto [end, ec] = std::from_chars(code.data(), code.data() + code.size(), _http_status);
+            if (ec != std::errc()) fail(error_code::bad_status);
+        }
+
+        void headers_done() {
+            // Only a response whose end is known leaves the connection usable
+            _persistent = _persistent && (_remaining >= 0 || _http_status == 304);
+            if (_http_status == 304) return finish(status::not_modified);
+            if (_http_status != 200) return fail(error_code::bad_status);
+
+            if (!_binary) {
+                if (!_sample_ts) return fail(_sample_ts.error());
+                // Timestamps are written straight into the caller's range, the parse stops once it is full
+                _json.emplace(arrivals_writer<timestamp_t*>{_out, _capacity}, arriving_at_schema);
+            }
+            _stage = stage::body;
+            if (_remaining == 0) finish_body();
+        }
+
+        void body(const char* data, std::size_t length) {
+            if (_remaining >= 0) {
+                length = std::min<std::size_t>(length, _remaining);
+                _remaining -= length;
+            }
+
+            if (_binary) {
+                std::size_t kept = std::min(length, sizeof(_records) - _records_length);
+                std::memcpy(_records + _records_length, data, kept);
+                _records_length += kept;
+                if (_records_length == sizeof(_records)) return finish_body();
+            } else if (_json->feed(data, length) != sax_status::ok) {
+                // Stopped once the range is full, or an error finish() reports
+                return finish_body();
+            }
+
+            if (_remaining == 0) finish_body();
+        }
+
+        void finish_body() {
+            if (_binary) {
+                // A body longer than the buffer is cut short on purpose, any other has to be whole
+                bool cut = _records_length == sizeof(_records);
+                auto arrivals = wire::arrivals_view::decode(_records, _records_length, cut);
+                if (!arrivals) return fail(arrivals.error());
+                _count = wire::next_arrivals(arrivals.value(), _out, _capacity);
+                _sample_ts = arrivals.value().sample_ts();
+            } else {
+                auto error = to_error(_json->finish());
+                if (error != error_code::none) return fail(error);
+                _count = _json->sink().count;
+            }
+
+            // Only revalidate against a response we actually used
+            if (_count > 0) copy(std::string_view(_response_etag), _etag);
+            else _etag[0] = '\0';
+
+            // Stopped before the end of the body; the rest has to be read before the next request
+            if (_persistent && _keep_alive_ms > 0 && _remaining > 0) {
+                _json.reset();
+                _stage = stage::drain;
+                return;
+            }
+            finish(status::done);
+        }
+    };
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <NextStopClient.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <optional>
+
+namespace next_stop {
+
+    // What a response told us about the data, all in server time
+    struct poll_sample {
+        timestamp_t sample_ts;                // when the server answered
+        std::optional<timestamp_t> feed_ts;   // when the server's feed was produced, x-feed-timestamp
+        std::optional<timestamp_t> soonest;   // earliest upcoming arrival, none when no train is due
+    };
+
+    // A poll policy decides how long to wait before the next poll. Any class with these two
+    // members can be used; they return the delay in milliseconds:
+    //   unsigned long on_response(const poll_sample& sample)   a 200 or 304 was received
+    //   unsigned long on_failure()                             the fetch failed
+
+    // The same period whatever the data, and a fixed delay after a failure
+    struct fixed_poll {
+        unsigned long period_ms;
+        unsigned long retry_ms;
+
+        unsigned long on_response(const poll_sample&) const { return period_ms; }
+        unsigned long on_failure() const { return retry_ms; }
+    };
+
+    struct adaptive_poll_config {
+        // Bounds of the delay after a response
+        unsigned long min_ms = 15000;
+        unsigned long max_ms = 600000;
+        // Aim for this many polls before the soonest train arrives
+        unsigned polls_before_arrival = 2;
+        // How often the server's feed is refreshed, and how long after that new data is expected
+        timestamp_t feed_period_s = 30;
+        timestamp_t feed_margin_s = 5;
+        // A feed older than this has stopped updating, polls aren't timed to its refreshes
+        timestamp_t feed_stale_s = 300;
+        // The first retry after a failure, doubling with every failure that follows up to the cap
+        unsigned long retry_ms = 2000;
+        unsigned long max_backoff_ms = 300000;
+    };
+
+    // Polls often when a train is close and rarely when none is due, times the polls to land just
+    // after the server's feed should have been refreshed, and backs off exponentially with jitter
+    // while fetches fail. Times are passed in, so it runs as well against a simulated clock.
+    class adaptive_poll {
+        adaptive_poll_config _config;
+        unsigned _failures = 0;
+        uint32_t _random;
+
+        public:
+        explicit adaptive_poll(adaptive_poll_config config = {}, uint32_t seed = 1) :
+            _config(config), _random(seed ? seed : 1) {}
+
+        // Reseeds the jitter, e.g. from a hardware random source once it is available
+        void seed(uint32_t seed) { _random = seed ? seed : 1; }
+
+        const adaptive_poll_config& config() const { return _config; }
+        // Failures since the last response
+        unsigned failures() const { return _failures; }
+
+        unsigned long on_response(const poll_sample& sample) {
+            _failures = 0;
+
+            timestamp_t delay = _config.max_ms;
+            if (sample.soonest) {
+                timestamp_t polls = std::max(_config.polls_before_arrival, 1u);
+                timestamp_t lead = std::clamp<timestamp_t>(seconds_between(sample.sample_ts, *sample.soonest),
+                                                           0, _config.max_ms / 1000 * polls);
+                delay = lead * 1000 / polls;
+            }
+            delay = std::clamp<timestamp_t>(delay, _config.min_ms, _config.max_ms);
+
+            if (sample.feed_ts) delay = align_to_feed(delay, *sample.feed_ts, sample.sample_ts);
+            return static_cast<unsigned long>(delay);
+        }
+
+        unsigned long on_failure() {
+            unsigned shift = std::min(_failures, 20u);
+            _failures++;
+
+            auto backoff = static_cast<unsigned long>(
+                std::min<uint64_t>(uint64_t(_config.retry_ms) << shift, _config.max_backoff_ms));
+            // Equal jitter: at least half the backoff, so devices that failed together spread out
+            unsigned long half = backoff / 2;
+            return backoff - half + next_random() % (half + 1);
+        }
+
+        private:
+        // Moves the delay to the last expected feed refresh before it, or the first one when it
+        // comes sooner. A poll between refreshes only gets the same snapshot again. A refresh due
+        // sooner than min_ms is skipped for the first one after it.
+        timestamp_t align_to_feed(timestamp_t delay, timestamp_t feed_ts, timestamp_t sample_ts) const {
+            timestamp_t age = seconds_between(feed_ts, sample_ts);
+            if (age < 0 || age > _config.feed_stale_s || _config.feed_period_s <= 0) return delay;
+
+            timestamp_t period = _config.feed_period_s * 1000;
+            timestamp_t refresh = (_config.feed_period_s + _config.feed_margin_s - age) * 1000;
+            if (refresh <= 0) return delay;
+            timestamp_t min_ms = _config.min_ms;
+            if (refresh < min_ms) refresh += (min_ms - refresh + period - 1) / period * period;
+            if (delay > refresh) refresh += (delay - refresh) / period * period;
+            return std::max<timestamp_t>(std::min<timestamp_t>(refresh, _config.max_ms), min_ms);
+        }
+
+        // `to - from`, saturated; the server's timestamps are untrusted
+        static timestamp_t seconds_between(timestamp_t from, timestamp_t to) {
+            timestamp_t seconds;
+            if (__builtin_sub_overflow(to, from, &seconds)) {
+                return to < from ? std::numeric_limits<timestamp_t>::min() : std::numeric_limits<timestamp_t>::max();
+            }
+            return seconds;
+        }
+
+        // xorshift32, enough to spread out retries
+        uint32_t next_random() {
+            _random ^= _random << 13;
+            _random ^= _random >> 17;
+            _random ^= _random << 5;
+            return _random;
+        }
+    };
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <limits>
+
+namespace scheduler {
+
+// True when `a` comes before `b` on a millisecond clock that wraps around
+inline bool before(unsigned long a, unsigned long b) { return static_cast<long>(a - b) < 0; }
+
+struct task_stats {
+  unsigned long runs;
+  // Runs that took longer than the task's budget
+  unsigned long overruns;
+  unsigned long longest_ms;
+};
+
+// A task gets the time it was started at and the deadline its budget allows, so work that can be
+// split (e.g. network steps) can stop once the deadline passes
+using task_fn = void (*)(void* context, unsigned long now, unsigned long deadline);
+
+// Cooperative scheduler over a fixed table of periodic tasks. tick() runs the tasks that are due,
+// earliest deadline first, each at most once per tick. Time comes from Clock::now() in milliseconds,
+// so tests can drive it with a fake clock.
+template <class Clock, std::size_t N>
+class Scheduler {
+  struct task {
+    const char* name;
+    task_fn run;
+    void* context;
+    unsigned long period_ms;
+    unsigned long budget_ms;
+    unsigned long due;
+    unsigned long tick;
+    // Set by run_in, so a task rescheduling itself keeps the time it asked for
+    bool moved;
+    task_stats stats;
+  };
+
+  Clock& _clock;
+  task _tasks[N];
+  std::size_t _size;
+  unsigned long _ticks;
+
+  public:
+  explicit Scheduler(Clock& clock) : _clock(clock), _tasks(), _size(0), _ticks(0) {}
+
+  static constexpr std::size_t capacity() { return N; }
+  std::size_t size() const { return _size; }
+
+  // Returns the task's id, or -1 once the table is full. The first run is `delay_ms` from now.
+  int add(const char* name, task_fn run, void* context, unsigned long period_ms, unsigned long budget_ms,
+          unsigned long delay_ms = 0) {
+    if (_size == N) return -1;
+
+    _tasks[_size] = task{name, run, context, period_ms, budget_ms, _clock.now() + delay_ms, _ticks, false, {}};
+    return static_cast<int>(_size++);
+  }
+
+  // Moves the next run of a task, e.g. to retry sooner or back off. A task may call it on itself
+  // while running, its period then doesn't apply to this run.
+  void run_in(int id, unsigned long delay_ms) {
+    _tasks[id].due = _clock.now() + delay_ms;
+    _tasks[id].moved = true;
+  }
+
+  const char* name(int id) const { return _tasks[id].name; }
+  const task_stats& stats(int id) const { return _tasks[id].stats; }
+
+  // Runs every due task and returns the milliseconds until the next one is due
+  unsigned long tick() {
+    _ticks++;
+    for (;;) {
+      unsigned long now = _clock.now();
+      task* next = nullptr;
+      for (std::size_t i = 0; i < _size; i++) {
+        task& t = _tasks[i];
+        if (t.tick == _ticks || before(now, t.due)) continue;
+        if (next == nullptr || before(t.due, next->due)) next = &t;
+      }
+      if (next == nullptr) break;
+
+      next->tick = _ticks;
+      run(*next, now);
+    }
+    return idle_ms();
+  }
+
+  // Milliseconds until the next task is due, 0 when one already is
+  unsigned long idle_ms() const {
+    unsigned long now = _clock.now();
+    unsigned long idle = std::numeric_limits<unsigned long>::max();
+    for (std::size_t i = 0; i < _size; i++) {
+      unsigned long wait = before(now, _tasks[i].due) ? _tasks[i].due - now : 0;
+      if (wait < idle) idle = wait;
+    }
+    return idle;
+  }
+
+  private:
+  void run(task& t, unsigned long now) {
+    t.moved = false;
+    t.run(t.context, now, now + t.budget_ms);
+
+    unsigned long took = _clock.now() - now;
+    t.stats.runs++;
+    if (took > t.budget_ms) t.stats.overruns++;
+    if (took > t.stats.longest_ms) t.stats.longest_ms = took;
+
+    if (t.moved) return;
+    // Keeps the cadence, but a task that fell more than a period behind skips the runs it missed
+    // instead of bursting to catch up
+    t.due += t.period_ms;
+    if (!before(now, t.due)) t.due = now + t.period_ms;
+  }
+};
+
+}
@@ -1,30 +1,62 @@
 #pragma once
 
+#include <cstdint>
 #include <iostream>
 #include <stdexcept>
 #include <vector>
 #include <initializer_list>
 #include <algorithm>
+#include <functional>
+#include <variant>
+#include <array>
+#include <string_view>
+#include <utility>
 
 namespace symbol {
 
+// One 8-pixel column of a glyph; bit i is row i
+struct column {
+    uint8_t bits;
+
+    constexpr bool operator[](std::size_t row) const { return (bits >> row) & 1; }
+};
+
+template<std::size_t Cols>
+struct packed_columns {
+    uint8_t bits[Cols];
+};
+
+// Packs a column-major 0/1 pixel table into one byte per column, at compile time
+template<std::size_t N>
+constexpr packed_columns<N / 8> pack(const char (&pixels)[N]) {
+    static_assert(N % 8 == 0, "glyphs are 8 pixels tall");
+
+    packed_columns<N / 8> packed{};
+    for (std::size_t col = 0; col < N / 8; col++) {
+        for (std::size_t row = 0; row < 8; row++) {
+            if (pixels[col * 8 + row]) packed.bits[col] |= 1 << row;
+        }
+    }
+    return packed;
+}
+
 class RowsIter {
     public: 
-    const char* _p;
+    const uint8_t* _p;
     std::size_t _sz;
     RowsIter() : _p(0), _sz(0) {}
-    RowsIter(const char* p, std::size_t sz) : _p(p), _sz(sz) {}
+    RowsIter(const uint8_t* p, std::size_t sz) : _p(p), _sz(sz) {}
 
     const RowsIter& begin() const { return *this; }
-    const RowsIter end() const { return RowsIter(_p + _sz, 0); }
+    const RowsIter end() const { return RowsIter(_p + _sz / 8, 0); }
 
     inline const RowsIter& operator++ ()  {
-        _p += 8; _sz -= 8;
+        _p += 1; _sz -= 8;
         return *this;
     }
 
-    const char* operator*() const {
-        return _p;
+    column operator*() const {
+        return column{*_p};
     }
 
     inline bool operator== (const RowsIter& rhs) { return (_p == rhs._p); }
@@ -41,17 +73,28 @@ class ISymbol {
     Iter rows_iter() const {
       return static_cast<const Symb*>(this)->rows_iter();
     }
+
+    // A blank column past cols()
+    column column_at(std::size_t i) const {
+      return static_cast<const Symb*>(this)->column_at(i);
+    }
+
+    // Columns [begin, end), clipped to cols()
+    Iter slice(std::size_t begin, std::size_t end) const {
+      return static_cast<const Symb*>(this)->slice(begin, end);
+    }
 };
 
 class constSym8 : public ISymbol<constSym8, RowsIter> {
-    const char* p;
+    const uint8_t* p;
     std::size_t sz;
 
     public:
         using It = RowsIter;
 
-        template<std::size_t N>
-        constexpr constSym8(const char(&a)[N]): p(a), sz(N) {}
+        template<std::size_t Cols>
+        constexpr constSym8(const packed_columns<Cols>& packed): p(packed.bits), sz(Cols * 8) {}
+        constexpr constSym8(const uint8_t* columns, std::size_t cols): p(columns), sz(cols * 8) {}
 
         constexpr std::size_t size() const { return sz; }
         constexpr std::size_t cols() const { return sz / 8; }
@@ -63,53 +106,66 @@ class constSym8 : public ISymbol<constSym8, RowsIter> {
         RowsIter rows_iter() const {
             return RowsIter(p, sz);
         }
+
+        column column_at(std::size_t i) const {
+            return i < cols() ? column{p[i]} : column{};
+        }
+
+        RowsIter slice(std::size_t begin, std::size_t end) const {
+            end = std::min(end, cols());
+            begin = std::min(begin, end);
+            return RowsIter(p + begin, (end - begin) * 8);
+        }
 };
 
+// Walks the columns of a contiguous run of symbols in place, starting `skip` columns into the
+// first one and stopping after `count` columns
 class ChainedIter {
     using inner_type = constSym8::It;
 
-    std::vector<inner_type> _iterators;
-
-    typename std::vector<inner_type>::const_iterator outer;
-    typename std::vector<inner_type>::const_iterator outer_end;
+    const constSym8* const* outer;
+    const constSym8* const* outer_end;
     inner_type inner;
+    std::size_t remaining;
 
-
-    ChainedIter(typename std::vector<inner_type>::const_iterator outer, inner_type inner) : outer(outer), outer_end(outer), inner(inner) {};
+    ChainedIter(const constSym8* const* outer, const constSym8* const* outer_end, inner_type inner) :
+    outer(outer), outer_end(outer_end), inner(inner), remaining(0) {};
 
     public: 
-    ChainedIter(std::vector<inner_type>&& iterators) :
-    _iterators(std::move(iterators)), 
-    outer(_iterators.cbegin()),
-    outer_end(_iterators.cend())
-     {
-        if (outer != _iterators.end()) {
-            inner = outer->begin();
+    ChainedIter(const constSym8* const* first, const constSym8* const* last, std::size_t skip, std::size_t count) :
+    outer(first), outer_end(last), remaining(count) {
+        while (outer != outer_end && skip >= (*outer)->cols()) {
+            skip -= (*outer)->cols();
+            ++outer;
+        }
+
+        if (outer == outer_end || remaining == 0) {
+            outer = outer_end;
+        } else {
+            inner = (*outer)->slice(skip, (*outer)->cols());
         }
     }
 
     const ChainedIter& begin() const { return *this; }
     const ChainedIter end() const { 
-        return ChainedIter(_iterators.end(), inner_type()); 
+        return ChainedIter(outer_end, outer_end, inner_type()); 
     }
 
     inline const ChainedIter& operator++ ()  {
-        // std::cout << "inc inner\n" ;
         ++inner;
         
-        if (inner == outer->end()) {
-            // std::cout << "inc outer\n" ;
+        if (--remaining == 0) {
+            outer = outer_end;
+            inner = inner_type();
+        } else if (inner == (*outer)->rows_iter().end()) {
             ++outer;
-            if (outer != outer_end) inner = outer->begin();
-            else {
-                // std::cout << "outer ended\n" ;
-                inner = inner_type();
-            }
+            if (outer != outer_end) inner = (*outer)->rows_iter();
+            else inner = inner_type();
         }
         return *this;
     }
 
-    inline const char* operator*() const {
+    inline column operator*() const {
         return *inner;
     }
 
@@ -117,51 +173,174 @@ class ChainedIter {
     inline bool operator!= (const ChainedIter& rhs) { return !(*this == rhs); }
 };
 
-class SymbolArray : public ISymbol<SymbolArray, ChainedIter> {
-    // TODO: This class mains copies of symbols.
-    // Since all symbols are static in this code, it could potentially just hold const pointers. 
+// Room for three arrivals of up to three digits, each followed by a gap
+constexpr std::size_t DEFAULT_SYMBOLS = 32;
 
-    std::vector<constSym8> _symbols; // one downside of static interface, is the container is limited to a single type of ISymbol<T>
+// A fixed-capacity run of static glyphs. Holds pointers, so every symbol has to outlive the array.
+template<std::size_t N = DEFAULT_SYMBOLS>
+class SymbolArray : public ISymbol<SymbolArray<N>, ChainedIter> {
+    const constSym8* _symbols[N] = {};
+    std::size_t _size;
     std::size_t _cols;
-    
-    void setCols() {
-        _cols = 0;
-        for(const auto& s : _symbols) {
-            _cols += s.cols();
+
+    public:
+    constexpr SymbolArray(std::initializer_list<std::reference_wrapper<const constSym8>> init) : _size(0), _cols(0) {
+        for (const constSym8& s : init) append(s);
+    }
+    constexpr SymbolArray() : _size(0), _cols(0) {};
+
+    static constexpr std::size_t capacity() { return N; }
+    constexpr std::size_t size() const { return _size; }
+    constexpr std::size_t cols() const { return _cols; }
+
+    ChainedIter rows_iter() const {
+        return ChainedIter(_symbols, _symbols + _size, 0, _cols);
+    }
+
+    // Skips whole glyphs to reach column i
+    column column_at(std::size_t i) const {
+        const constSym8* const* s = _symbols;
+        const constSym8* const* last = _symbols + _size;
+        while (s != last && i >= (*s)->cols()) {
+            i -= (*s)->cols();
+            ++s;
         }
+        return s == last ? column{} : (*s)->column_at(i);
+    }
+
+    ChainedIter slice(std::size_t begin, std::size_t end) const {
+        end = std::min(end, _cols);
+        begin = std::min(begin, end);
+        return ChainedIter(_symbols, _symbols + _size, begin, end - begin);
+    }
+
+    // Returns false, leaving the array unchanged, once it is full
+    constexpr bool append(const constSym8& symbol) {
+        if (_size == N) return false;
+
+        _symbols[_size++] = &symbol;
+        _cols += symbol.cols();
+        return true;
+    }
+
+    constexpr void clear() {
+      _size = 0;
+      _cols = 0;
     }
+};
+
+// Columns of a symbol flattened into one buffer, so a window of them can be read without walking
+// the glyphs. Rendering stops at Cols columns.
+template<std::size_t Cols>
+class ColumnBitmap : public ISymbol<ColumnBitmap<Cols>, RowsIter> {
+    uint8_t _bits[Cols];
+    std::size_t _cols;
 
     public:
-    SymbolArray(std::initializer_list<constSym8> init) : _symbols(init) { setCols(); }
-    SymbolArray() : SymbolArray({}) {};
+    ColumnBitmap() : _cols(0) {}
 
+    static constexpr std::size_t capacity() { return Cols; }
     std::size_t cols() const { return _cols; }
 
-    ChainedIter rows_iter() const {
-        std::vector<constSym8::It> result(_symbols.size());
-        std::transform(
-            _symbols.begin(), 
-            _symbols.end(),
-            result.begin(),
-            [](const constSym8& x) { return x.rows_iter(); }
-        );
-        return ChainedIter(std::move(result));
+    RowsIter rows_iter() const {
+        return RowsIter(_bits, _cols * 8);
+    }
+
+    column column_at(std::size_t i) const {
+        return i < _cols ? column{_bits[i]} : column{};
+    }
+
+    // Columns [begin, end), clipped to the rendered ones
+    RowsIter slice(std::size_t begin, std::size_t end) const {
+        end = std::min(end, _cols);
+        begin = std::min(begin, end);
+        return RowsIter(_bits + begin, (end - begin) * 8);
+    }
+
+    template<class Symb, class Iter>
+    void render(const ISymbol<Symb, Iter>& symbol) {
+        _cols = 0;
+        append(symbol);
+    }
+
+    // Both return false once the bitmap is full, keeping the columns that fit
+    template<class Symb, class Iter>
+    bool append(const ISymbol<Symb, Iter>& symbol) {
+        for (auto c : symbol.rows_iter()) {
+            if (_cols == Cols) return false;
+            _bits[_cols++] = c.bits;
+        }
+        return true;
+    }
+
+    bool append_blank(std::size_t cols) {
+        for (; cols > 0; cols--) {
+            if (_cols == Cols) return false;
+            _bits[_cols++] = 0;
+        }
+        return true;
+    }
+
+    void clear() {
+        _cols = 0;
     }
+};
+
+// A display line made of segments of different symbol kinds, each with its own color. Segments are
+// dispatched through std::variant, so the line is built once and drawn without virtual calls or
+// temporaries. Holds pointers, so every symbol has to outlive the line. At most one segment
+// should scroll, and it should be the last one.
+template<class Color, std::size_t N, class... Symbols>
+class Line {
+    struct segment {
+        std::variant<const Symbols*...> symbol;
+        Color color;
+        bool scrolls;
+    };
+
+    segment _segments[N];
+    std::size_t _size;
+
+    public:
+    Line() : _size(0) {}
+
+    static constexpr std::size_t capacity() { return N; }
+    std::size_t size() const { return _size; }
+
+    std::size_t cols() const {
+        std::size_t cols = 0;
+        for_each([&](const auto& symbol, const Color&, bool) { cols += symbol.cols(); });
+        return cols;
+    }
+
+    // Returns false, leaving the line unchanged, once it is full
+    template<class Symb>
+    bool add(const Symb& symbol, const Color& color, bool scrolls = false) {
+        if (_size == N) return false;
 
-    void append(const constSym8& symbol) {
-        _symbols.push_back(symbol);
-        setCols();
+        _segments[_size++] = segment{&symbol, color, scrolls};
+        return true;
     }
+    template<class Symb>
+    bool add(const Symb&& symbol, const Color& color, bool scrolls = false) = delete;
 
     void clear() {
-      _symbols.clear();
-      setCols();
+        _size = 0;
+    }
+
+    // Calls f(symbol, color, scrolls) for every segment in order
+    template<class F>
+    void for_each(F&& f) const {
+        for (std::size_t i = 0; i < _size; i++) {
+            const segment& s = _segments[i];
+            std::visit([&](auto* symbol) { f(*symbol, s.color, s.scrolls); }, s.symbol);
+        }
     }
 };
 
 #define DEFINE_SYM(NAME, ...) \
-constexpr char raw##NAME[] = {__VA_ARGS__}; \
-constexpr constSym8 NAME(raw##NAME);
+constexpr auto packed##NAME = pack({__VA_ARGS__}); \
+constexpr constSym8 NAME(packed##NAME);
 
 DEFINE_SYM(SPACE,
   0, 0, 0, 0, 0, 0, 0, 0,
@@ -275,13 +454,207 @@ const constSym8* const SYM_NUMERIC[] = {
   &ZERO, &ONE, &TWO, &THREE, &FOUR, &FIVE, &SIX, &SEVEN, &EIGHT, &NINE
 };
 
-void addNumberToArray(SymbolArray& symb, int n) { 
-  if (n == 0) return;
-  addNumberToArray(symb, n / 10);
+namespace font {
+
+constexpr char FIRST = ' ';
+constexpr char LAST = '~';
+constexpr std::size_t GLYPHS = LAST - FIRST + 1;
+
+// The classic 5x7 LCD font for printable ASCII, one byte per column with bit 0 the top row
+constexpr uint8_t FONT_5X7[GLYPHS][5] = {
+  {0x00, 0x00, 0x00, 0x00, 0x00}, // ' '
+  {0x00, 0x00, 0x5F, 0x00, 0x00}, // !
+  {0x00, 0x07, 0x00, 0x07, 0x00}, // "
+  {0x14, 0x7F, 0x14, 0x7F, 0x14}, // #
+  {0x24, 0x2A, 0x7F, 0x2A, 0x12}, // $
+  {0x23, 0x13, 0x08, 0x64, 0x62}, // %
+  {0x36, 0x49, 0x55, 0x22, 0x50}, // &
+  {0x00, 0x05, 0x03, 0x00, 0x00}, // '
+  {0x00, 0x1C, 0x22, 0x41, 0x00}, // (
+  {0x00, 0x41, 0x22, 0x1C, 0x00}, // )
+  {0x14, 0x08, 0x3E, 0x08, 0x14}, // *
+  {0x08, 0x08, 0x3E, 0x08, 0x08}, // +
+  {0x00, 0x50, 0x30, 0x00, 0x00}, // ,
+  {0x08, 0x08, 0x08, 0x08, 0x08}, // -
+  {0x00, 0x60, 0x60, 0x00, 0x00}, // .
+  {0x20, 0x10, 0x08, 0x04, 0x02}, // /
+  {0x3E, 0x51, 0x49, 0x45, 0x3E}, // 0
+  {0x00, 0x42, 0x7F, 0x40, 0x00}, // 1
+  {0x42, 0x61, 0x51, 0x49, 0x46}, // 2
+  {0x21, 0x41, 0x45, 0x4B, 0x31}, // 3
+  {0x18, 0x14, 0x12, 0x7F, 0x10}, // 4
+  {0x27, 0x45, 0x45, 0x45, 0x39}, // 5
+  {0x3C, 0x4A, 0x49, 0x49, 0x30}, // 6
+  {0x01, 0x71, 0x09, 0x05, 0x03}, // 7
+  {0x36, 0x49, 0x49, 0x49, 0x36}, // 8
+  {0x06, 0x49, 0x49, 0x29, 0x1E}, // 9
+  {0x00, 0x36, 0x36, 0x00, 0x00}, // :
+  {0x00, 0x56, 0x36, 0x00, 0x00}, // ;
+  {0x08, 0x14, 0x22, 0x41, 0x00}, // <
+  {0x14, 0x14, 0x14, 0x14, 0x14}, // =
+  {0x00, 0x41, 0x22, 0x14, 0x08}, // >
+  {0x02, 0x01, 0x51, 0x09, 0x06}, // ?
+  {0x32, 0x49, 0x79, 0x41, 0x3E}, // @
+  {0x7E, 0x11, 0x11, 0x11, 0x7E}, // A
+  {0x7F, 0x49, 0x49, 0x49, 0x36}, // B
+  {0x3E, 0x41, 0x41, 0x41, 0x22}, // C
+  {0x7F, 0x41, 0x41, 0x22, 0x1C}, // D
+  {0x7F, 0x49, 0x49, 0x49, 0x41}, // E
+  {0x7F, 0x09, 0x09, 0x09, 0x01}, // F
+  {0x3E, 0x41, 0x49, 0x49, 0x7A}, // G
+  {0x7F, 0x08, 0x08, 0x08, 0x7F}, // H
+  {0x00, 0x41, 0x7F, 0x41, 0x00}, // I
+  {0x20, 0x40, 0x41, 0x3F, 0x01}, // J
+  {0x7F, 0x08, 0x14, 0x22, 0x41}, // K
+  {0x7F, 0x40, 0x40, 0x40, 0x40}, // L
+  {0x7F, 0x02, 0x0C, 0x02, 0x7F}, // M
+  {0x7F, 0x04, 0x08, 0x10, 0x7F}, // N
+  {0x3E, 0x41, 0x41, 0x41, 0x3E}, // O
+  {0x7F, 0x09, 0x09, 0x09, 0x06}, // P
+  {0x3E, 0x41, 0x51, 0x21, 0x5E}, // Q
+  {0x7F, 0x09, 0x19, 0x29, 0x46}, // R
+  {0x46, 0x49, 0x49, 0x49, 0x31}, // S
+  {0x01, 0x01, 0x7F, 0x01, 0x01}, // T
+  {0x3F, 0x40, 0x40, 0x40, 0x3F}, // U
+  {0x1F, 0x20, 0x40, 0x20, 0x1F}, // V
+  {0x3F, 0x40, 0x38, 0x40, 0x3F}, // W
+  {0x63, 0x14, 0x08, 0x14, 0x63}, // X
+  {0x07, 0x08, 0x70, 0x08, 0x07}, // Y
+  {0x61, 0x51, 0x49, 0x45, 0x43}, // Z
+  {0x00, 0x7F, 0x41, 0x41, 0x00}, // [
+  {0x02, 0x04, 0x08, 0x10, 0x20}, // backslash
+  {0x00, 0x41, 0x41, 0x7F, 0x00}, // ]
+  {0x04, 0x02, 0x01, 0x02, 0x04}, // ^
+  {0x40, 0x40, 0x40, 0x40, 0x40}, // _
+  {0x00, 0x01, 0x02, 0x04, 0x00}, // `
+  {0x20, 0x54, 0x54, 0x54, 0x78}, // a
+  {0x7F, 0x48, 0x44, 0x44, 0x38}, // b
+  {0x38, 0x44, 0x44, 0x44, 0x20}, // c
+  {0x38, 0x44, 0x44, 0x48, 0x7F}, // d
+  {0x38, 0x54, 0x54, 0x54, 0x18}, // e
+  {0x08, 0x7E, 0x09, 0x01, 0x02}, // f
+  {0x0C, 0x52, 0x52, 0x52, 0x3E}, // g
+  {0x7F, 0x08, 0x04, 0x04, 0x78}, // h
+  {0x00, 0x44, 0x7D, 0x40, 0x00}, // i
+  {0x20, 0x40, 0x44, 0x3D, 0x00}, // j
+  {0x7F, 0x10, 0x28, 0x44, 0x00}, // k
+  {0x00, 0x41, 0x7F, 0x40, 0x00}, // l
+  {0x7C, 0x04, 0x18, 0x04, 0x78}, // m
+  {0x7C, 0x08, 0x04, 0x04, 0x78}, // n
+  {0x38, 0x44, 0x44, 0x44, 0x38}, // o
+  {0x7C, 0x14, 0x14, 0x14, 0x08}, // p
+  {0x08, 0x14, 0x14, 0x18, 0x7C}, // q
+  {0x7C, 0x08, 0x04, 0x04, 0x08}, // r
+  {0x48, 0x54, 0x54, 0x54, 0x20}, // s
+  {0x04, 0x3F, 0x44, 0x40, 0x20}, // t
+  {0x3C, 0x40, 0x40, 0x20, 0x7C}, // u
+  {0x1C, 0x20, 0x40, 0x20, 0x1C}, // v
+  {0x3C, 0x40, 0x30, 0x40, 0x3C}, // w
+  {0x44, 0x28, 0x10, 0x28, 0x44}, // x
+  {0x0C, 0x50, 0x50, 0x50, 0x3C}, // y
+  {0x44, 0x64, 0x54, 0x4C, 0x44}, // z
+  {0x00, 0x08, 0x36, 0x41, 0x00}, // {
+  {0x00, 0x00, 0x7F, 0x00, 0x00}, // |
+  {0x00, 0x41, 0x36, 0x08, 0x00}, // }
+  {0x08, 0x04, 0x08, 0x10, 0x08}, // ~
+};
+
+struct table {
+    uint8_t bits[GLYPHS * 5];
+    // Glyph g covers bits[start[g]] up to bits[start[g + 1]]
+    std::size_t start[GLYPHS + 1];
+};
+
+// Drops the blank columns around each glyph, so narrow glyphs take fewer columns, and moves the
+// rows down by one to sit on the same baseline as the digits. A blank glyph keeps one column.
+constexpr table trim(const uint8_t (&raw)[GLYPHS][5]) {
+    table t{};
+    std::size_t n = 0;
+    for (std::size_t g = 0; g < GLYPHS; g++) {
+        std::size_t first = 0, last = 0;
+        while (first < 5 && raw[g][first] == 0) first++;
+        if (first == 5) {
+            first = 0;
+        } else {
+            last = 4;
+            while (raw[g][last] == 0) last--;
+        }
+
+        t.start[g] = n;
+        for (std::size_t c = first; c <= last; c++) t.bits[n++] = raw[g][c] << 1;
+    }
+    t.start[GLYPHS] = n;
+    return t;
+}
+
+constexpr table TABLE = trim(FONT_5X7);
+
+template<std::size_t... G>
+constexpr std::array<constSym8, GLYPHS> glyphs(std::index_sequence<G...>) {
+    return {constSym8(TABLE.bits + TABLE.start[G], TABLE.start[G + 1] - TABLE.start[G])...};
+}
+
+constexpr std::array<constSym8, GLYPHS> GLYPH = glyphs(std::make_index_sequence<GLYPHS>());
+
+}
+
+// Characters outside printable ASCII are drawn as '?'
+constexpr const constSym8& glyph(char c) {
+    if (c < font::FIRST || c > font::LAST) c = '?';
+    return font::GLYPH[c - font::FIRST];
+}
+
+// Symbols layout() needs for `text`: a glyph per character and a gap between neighbours
+constexpr std::size_t layout_size(std::string_view text) {
+    return text.empty() ? 0 : 2 * text.size() - 1;
+}
+
+// Lays `text` out in the font, one column apart. Text past the capacity is dropped. Evaluated at
+// compile time when `text` is a constant, e.g.
+//   constexpr auto DELAYED = symbol::layout<symbol::layout_size("DELAYED")>("DELAYED");
+template<std::size_t N = DEFAULT_SYMBOLS>
+constexpr SymbolArray<N> layout(std::string_view text) {
+    SymbolArray<N> symbols;
+    for (std::size_t i = 0; i < text.size(); i++) {
+        if (i > 0) symbols.append(SPACE);
+        symbols.append(glyph(text[i]));
+    }
+    return symbols;
+}
+
+struct number_format {
+    // Minimum width in columns, shorter numbers are right-aligned with blank columns on the left
+    std::size_t width = 0;
+    // Drawn a column after the digits, e.g. &glyph('m')
+    const constSym8* suffix = nullptr;
+};
 
-  auto x = n % 10;
-  symb.append(*SYM_NUMERIC[x]);
-  symb.append(SPACE);
+// Appends n to `out`, one column between glyphs and none after the last. Returns false if it
+// didn't fit.
+template<std::size_t Cols>
+bool format_number(ColumnBitmap<Cols>& out, int n, const number_format& format = {}) {
+    // Least significant digit first: up to 10 digits and a sign
+    const constSym8* glyphs[11];
+    std::size_t count = 0;
+    unsigned magnitude = n < 0 ? 0u - static_cast<unsigned>(n) : static_cast<unsigned>(n);
+    do {
+        glyphs[count++] = SYM_NUMERIC[magnitude % 10];
+        magnitude /= 10;
+    } while (magnitude > 0);
+    if (n < 0) glyphs[count++] = &glyph('-');
+
+    std::size_t cols = count - 1;
+    for (std::size_t i = 0; i < count; i++) cols += glyphs[i]->cols();
+    if (format.suffix) cols += 1 + format.suffix->cols();
+
+    bool fits = cols >= format.width || out.append_blank(format.width - cols);
+    for (std::size_t i = count; fits && i > 0; i--) {
+        fits = out.append(*glyphs[i - 1]) && (i == 1 || out.append_blank(1));
+    }
+    if (fits && format.suffix) {
+        fits = out.append_blank(1) && out.append(*format.suffix);
+    }
+    return fits;
 }
 
 }
@@ -1,22 +1,32 @@
 #define FASTLED_ESP8266_NODEMCU_PIN_ORDER
 
-#include <ESP8266HTTPClient.h>
 #include <ESP8266WiFi.h>
 #include <ESP8266mDNS.h>
 #include <WiFiClient.h>
 #include <FastLED.h>
 #include <LittleFS.h>
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
 #include <NextStopClient.hpp>
+#include <NextStopFetch.hpp>
+#include <Countdown.hpp>
+#include <PollPolicy.hpp>
 #include <Config.hpp>
 #include <symbol.hpp>
+#include <Frame.hpp>
+#include <Scheduler.hpp>
+
+// One 8x32 panel, wired in columns that zigzag starting top to bottom. Chain more panels or
+// rotate the display by changing the layout.
+constexpr frame::panel_layout PANELS = { /* panel_cols */ 32, /* panel_rows */ 8 };
+static_assert(PANELS.height() >= 8, "symbols are 8 rows tall");
 
 // How many leds in your strip?
-#define LED_COLS 32
-#define NUM_LEDS (8*LED_COLS)
+constexpr int LED_COLS = PANELS.width();
+constexpr int NUM_LEDS = PANELS.leds();
 
 // For led chips like WS2812, which have a data line, ground, and power, you just
 // need to define DATA_PIN.  For led chipsets that are SPI based (four wires 0 data, clock,
@@ -28,82 +38,38 @@ int G_BRIGHTNESS = 2;
 
 // Define the array of leds
 CRGB leds[NUM_LEDS];
+// What the leds should show next; only the columns that changed are written to them
+frame::DirtyColumns<CRGB, LED_COLS> FRAME;
+// Display (x, y) -> leds index, built at compile time
+constexpr frame::PixelMap<LED_COLS, 8> PIXELS(PANELS);
 
 static const char* deviceName = "NextStop"; 
-static const char* timestampHeader = "x-timestamp";
-static const char* headerKeys[] = {
-    timestampHeader
-};
-#define HEADERS_KEYS_SIZE 1
-
-#define IDLE_CYCLES 10
-using vec_iter = std::vector<int>::iterator;
-
-class NextStopClient {
-  std::string _url;
-
-  public:
-  NextStopClient() {};
-
-  void setUrl(const std::string&& url) {
-    _url = url;
-  }
-
-  int getNextStops(vec_iter begin, const vec_iter& end) {
-    if (_url.length() == 0) {
-      Serial.print("Client not configured!\n");
-      return 0;
-    }
-
-    if (begin == end) {
-      Serial.print("Err: empty result buffer\n");
-      return 0;
-    }
-
-    WiFiClient client;
-    HTTPClient http;
-
-    Serial.print("[HTTP] begin...\n");
-
-    http.collectHeaders(headerKeys, HEADERS_KEYS_SIZE);
-    if (!http.begin(client, String(_url.c_str()))) {  // HTTP
-      Serial.printf("[HTTP} Unable to connect\n");
-      return 0;
-    }
-
-    Serial.print("[HTTP] GET...\n");
-    // start connection and send HTTP header
-    int httpCode = http.GET();
-
-    // httpCode will be negative on error
-    if (httpCode <= 0) {
-        Serial.printf("[HTTP] GET... failed, error: %s\n", http.errorToString(httpCode).c_str());
-        http.end();
-        return 0;
-    }
-
-    // HTTP header has been send and Server response header has been handled
-    Serial.printf("[HTTP] GET... code: %d\n", httpCode);
-
-    if (httpCode != HTTP_CODE_OK) {
-      http.end();
-      return 0;
-    }
-
-    auto payload = http.getString();
-    auto timestamp_str = http.header(timestampHeader);
-
-    auto result = next_stop::next_minutes(timestamp_str.c_str(), payload);
-    int c = 0;
-    for (auto i : result) {
-      *begin = i; c++;
-      if (++begin == end) { break; }
-    }
-
-    http.end();
-    return c;
-  }
-};
+static const char* configPath = "/next_stop.config";
+
+// Every task runs on its own period; the budget is how long one run may take
+#define FRAME_MS 800
+#define RENDER_BUDGET_MS 20
+#define FETCH_PERIOD_MS 10
+#define FETCH_BUDGET_MS 5
+#define CONFIG_WATCH_MS 5000
+#define CONFIG_WATCH_BUDGET_MS 50
+#define TELEMETRY_MS 60000
+#define TELEMETRY_BUDGET_MS 10
+
+// A fetch that hasn't finished by then is dropped
+#define FETCH_TIMEOUT_MS 10000
+// Bounds the one blocking step of a fetch, WiFiClient::connect. A connect that takes longer than
+// FRAME_MS delays a frame; reused keep-alive connections skip it.
+#define CONNECT_TIMEOUT_MS 2000
+// A kept-alive connection idle for longer is replaced, routers tend to drop them silently
+#define KEEP_ALIVE_MS 120000
+// Arrivals shown, and kept to take the place of trains that leave between polls
+#define SHOWN_ARRIVALS 3
+#define KEPT_ARRIVALS 8
+// Three arrivals of up to three digits with their gaps fit comfortably
+#define MINUTES_COLS 128
+// Two-digit minutes keep their place as they count down
+static const symbol::number_format MINUTES_FORMAT = { 2 * symbol::EIGHT.cols() + 1 };
 
 void setupWifi(const char* ssid, const char* password) {
   WiFi.mode(WIFI_STA);
@@ -132,37 +98,37 @@ void setupLeds() {
   // Serial.println("Added leds");
 }
 
-void drawColumn(int col, const char* row, CRGB color){
+void drawColumn(int col, symbol::column row, CRGB color){
   if (col < 0 || col >= LED_COLS) {
     Serial.printf("Error col bounds (%d)\n", col);
     return;
   }
 
+  FRAME.draw(col, row.bits, color);
+}
+
+void writeColumn(int col, uint8_t bits, const CRGB& color) {
+  symbol::column row{bits};
   for (int i = 0 ; i < 8; i++) {
-    auto d = row[(col % 2) == 0 ? i : 7 - i];
-    auto pix = col * 8 + i;
-    if (pix < NUM_LEDS) leds[pix] = color * (uint8_t)d;
+    leds[PIXELS(col, i)] = color * (uint8_t)row[i];
   }
 }
 
+// Only the columns that land in [start, end) are visited
 template <class Sym, class Iter>
 int drawSymbol(int col, const symbol::ISymbol<Sym, Iter>& symbol, CRGB color, int offset=0, int start=0, int end=LED_COLS) {
   end = min(end, LED_COLS);
   start = max(start, 0);
 
-  if (col - offset >=  end) 
-    return col;
-  
-  // if (col - offset + symbol.cols() < start) {
-  //   return col + symbol.cols();
-  // }
-
-  for (auto row : symbol.rows_iter()) {
-    auto c = col - offset;
-    if (c >= start && c < end) drawColumn(c, row, color);
-    col++;
+  int origin = col - offset;
+  int first = max(start - origin, 0);
+  int last = max(end - origin, first);
+
+  int c = origin + first;
+  for (auto row : symbol.slice(first, last)) {
+    drawColumn(c++, row, color);
   }
-  return col;
+  return col + symbol.cols();
 }
 
 void listDir(const char * dirname) {
@@ -208,40 +174,185 @@ void listDir(const char * dirname) {
 struct LoopState {
   std::vector<int> currentNextStops;
   int region_offset;
-  symbol::SymbolArray syms;
-  int cyclesSinceRequest;
+  // Rendered once per update, frames only copy the visible window out of it
+  symbol::ColumnBitmap<MINUTES_COLS> minutes;
   int configIx;
   config::Stop stop;
-
-
-  LoopState(): currentNextStops(3, 0), region_offset(0) {} ;
-  void reset(std::vector<int>& nextStops) {
-    currentNextStops = nextStops;
+  // Written by the running fetch
+  next_stop::timestamp_t fetched[KEPT_ARRIVALS];
+  // Upcoming arrivals, the minutes shown are recomputed from them every frame
+  next_stop::countdown<KEPT_ARRIVALS> arrivals;
+  // When the next fetch starts
+  unsigned long pollAt;
+  // Last seen state of the config file, a change reloads it
+  time_t configWrittenAt;
+  size_t configSize;
+
+
+  LoopState(): currentNextStops(SHOWN_ARRIVALS, 0), region_offset(0), pollAt(0), configWrittenAt(0), configSize(0) {} ;
+  void reset(const int* nextStops, size_t count) {
+    currentNextStops.assign(nextStops, nextStops + count);
     region_offset = 0;
 
-    syms.clear();
-    for (auto s : nextStops) {
-      if (s == 0) {
-        syms.append(*symbol::SYM_NUMERIC[0]);
-        syms.append(symbol::SPACE);
-        syms.append(symbol::SPACE);
-      } else {
-        symbol::addNumberToArray(syms, s);
-        syms.append(symbol::SPACE);
-        syms.append(symbol::SPACE);
-      }
+    minutes.clear();
+    for (auto s : currentNextStops) {
+      symbol::format_number(minutes, s, MINUTES_FORMAT);
+      minutes.append_blank(3);
     }
   }
 
+  // Counts the arrivals down to `now`, re-rendering the minutes only when one changed
+  void update(unsigned long now) {
+    if (!arrivals.synced()) return;
+
+    int nextStops[SHOWN_ARRIVALS];
+    size_t count = arrivals.minutes(now, nextStops, SHOWN_ARRIVALS);
+    if (count == currentNextStops.size() && std::equal(nextStops, nextStops + count, currentNextStops.begin())) return;
+    reset(nextStops, count);
+  }
+
   void inc() {
-    region_offset = (region_offset + 1) % syms.cols();
-    cyclesSinceRequest++;
+    if (minutes.cols() > 0) region_offset = (region_offset + 1) % minutes.cols();
   }
 };
 
+struct MillisClock {
+  unsigned long now() const { return millis(); }
+};
 
 LoopState LOOP_STATE; 
-NextStopClient client;
+// Line badge, direction and the scrolling minutes, drawn in a single pass
+symbol::Line<CRGB, 5, symbol::constSym8, symbol::ColumnBitmap<MINUTES_COLS>> DISPLAY_LINE;
+WiFiClient wifiClient;
+next_stop::fetcher<WiFiClient> client(wifiClient, FETCH_TIMEOUT_MS, KEEP_ALIVE_MS);
+MillisClock CLOCK;
+scheduler::Scheduler<MillisClock, 4> SCHEDULER(CLOCK);
+// When to poll next. Minutes count down locally in between, polls only pick up changed
+// predictions; next_stop::fixed_poll{80000, 1000} polls on a fixed period instead.
+next_stop::adaptive_poll POLL_POLICY;
+
+using fetch_status = next_stop::fetcher<WiFiClient>::status;
+
+// Points the display and the client at the config's active stop
+void applyConfig(const config::Config& conf) {
+  LOOP_STATE.stop.direction = conf.stops[conf.active_stop].direction;
+  LOOP_STATE.stop.url = conf.stops[conf.active_stop].url;
+
+  if (!client.set_url(LOOP_STATE.stop.url)) {
+    Serial.printf("Err: bad url '%s'\n", LOOP_STATE.stop.url.c_str());
+  }
+
+  DISPLAY_LINE.clear();
+  DISPLAY_LINE.add(symbol::ONE_TRAIN, CRGB::Green);
+  DISPLAY_LINE.add(symbol::SPACE, CRGB::Green);
+  DISPLAY_LINE.add((LOOP_STATE.stop.direction == config::Direction::South) ? symbol::ARROW_DOWN : symbol::ARROW_UP, CRGB::Yellow);
+  DISPLAY_LINE.add(symbol::SPACE, CRGB::Yellow);
+  DISPLAY_LINE.add(LOOP_STATE.minutes, CRGB::Red, true);
+}
+
+// Returns true when the config file was written since the last call
+bool configChanged() {
+  File file = LittleFS.open(configPath, "r");
+  if (!file) return false;
+  time_t writtenAt = file.getLastWrite();
+  size_t size = file.size();
+  file.close();
+
+  if (writtenAt == LOOP_STATE.configWrittenAt && size == LOOP_STATE.configSize) return false;
+  LOOP_STATE.configWrittenAt = writtenAt;
+  LOOP_STATE.configSize = size;
+  return true;
+}
+
+void onFetched(fetch_status status, unsigned long now) {
+  // Every response carries the server time, 304s included
+  auto sample_ts = client.sample_ts();
+  if (status == fetch_status::failed || !sample_ts) {
+    unsigned long delay = POLL_POLICY.on_failure();
+    Serial.printf("[HTTP] No new stops (%s), retrying in %lu ms\n", next_stop::describe(client.error()), delay);
+    LOOP_STATE.pollAt = now + delay;
+    return;
+  }
+  LOOP_STATE.arrivals.sync(sample_ts.value(), now);
+
+  if (status == fetch_status::not_modified) {
+    // Keep counting down what we have
+    Serial.printf("Stops not modified\n");
+  } else {
+    // None is a quiet stop, not an error
+    Serial.printf("Update next stops, %u arrivals\n", unsigned(client.count()));
+    LOOP_STATE.arrivals.assign(LOOP_STATE.fetched, client.count());
+  }
+  LOOP_STATE.update(now);
+
+  next_stop::poll_sample sample{sample_ts.value(), {}, {}};
+  auto feed_ts = client.feed_ts();
+  if (feed_ts) sample.feed_ts = feed_ts.value();
+  if (!LOOP_STATE.arrivals.empty()) sample.soonest = LOOP_STATE.arrivals[0];
+
+  unsigned long delay = POLL_POLICY.on_response(sample);
+  Serial.printf("Next poll in %lu ms\n", delay);
+  LOOP_STATE.pollAt = now + delay;
+}
+
+////////  Tasks  ////////
+
+void renderTask(void*, unsigned long now, unsigned long) {
+  LOOP_STATE.update(now);
+  FRAME.clear();
+
+  int col = 0;
+  DISPLAY_LINE.for_each([&](const auto& symbol, const CRGB& color, bool scrolls) {
+    // The scrolling segment is clipped to start where it is laid out
+    col = scrolls
+      ? drawSymbol(col, symbol, color, LOOP_STATE.region_offset, col)
+      : drawSymbol(col, symbol, color);
+  });
+
+  // Pushing the strip blocks interrupts for milliseconds, skip it when no column changed
+  if (FRAME.flush(writeColumn) > 0) FastLED.show();
+  LOOP_STATE.inc();
+}
+
+// Starts a poll when one is due, then advances the fetch as far as the budget allows
+void fetchTask(void*, unsigned long now, unsigned long deadline) {
+  if (!client.busy()) {
+    if (scheduler::before(now, LOOP_STATE.pollAt)) return;
+    client.start(LOOP_STATE.fetched, KEPT_ARRIVALS, now);
+  }
+
+  fetch_status status;
+  do {
+    status = client.step(now);
+    now = millis();
+  } while (status == fetch_status::busy && scheduler::before(now, deadline));
+
+  if (status != fetch_status::busy && status != fetch_status::idle) onFetched(status, now);
+}
+
+// Picks up a new active stop written to the config, WiFi credentials still need a restart
+void configWatchTask(void*, unsigned long now, unsigned long) {
+  if (!configChanged()) return;
+
+  config::Config conf;
+  if (!readConfig(configPath, &conf)) {
+    Serial.println("Err: Read config failed");
+    return;
+  }
+  applyConfig(conf);
+  // Arrivals of the previous stop don't apply anymore
+  LOOP_STATE.arrivals.clear();
+  LOOP_STATE.pollAt = now;
+}
+
+void telemetryTask(void*, unsigned long, unsigned long) {
+  for (size_t id = 0; id < SCHEDULER.size(); id++) {
+    const auto& stats = SCHEDULER.stats(id);
+    Serial.printf("[TASK] %s: %lu runs, %lu over budget, longest %lu ms\n",
+      SCHEDULER.name(id), stats.runs, stats.overruns, stats.longest_ms);
+  }
+  Serial.printf("[HTTP] %lu requests over %lu connections\n", client.requests(), client.handshakes());
+}
 
 void setup(void) {
   // pinMode(led, OUTPUT);
@@ -253,8 +364,11 @@ void setup(void) {
     return;
   }
 
+  LOOP_STATE = LoopState();
   config::Config conf;
-  if (!readConfig("/next_stop.config", &conf)) {
+  // Remember the file as read so the watch task only reacts to later writes
+  configChanged();
+  if (!readConfig(configPath, &conf)) {
     Serial.println("Err: Read config failed");
     return;
   }
@@ -262,61 +376,18 @@ void setup(void) {
   setupWifi(conf.connection.ssid.c_str(), conf.connection.password.c_str());
   setupLeds();
 
-  LOOP_STATE = LoopState();
-  LOOP_STATE.cyclesSinceRequest = IDLE_CYCLES;
-
-  LOOP_STATE.stop.direction = conf.stops[conf.active_stop].direction;
-  LOOP_STATE.stop.url = conf.stops[conf.active_stop].url;
+  wifiClient.setTimeout(CONNECT_TIMEOUT_MS);
+  POLL_POLICY.seed(ESP.random());
+  applyConfig(conf);
 
-  client.setUrl(std::string(LOOP_STATE.stop.url));
+  SCHEDULER.add("render", renderTask, nullptr, FRAME_MS, RENDER_BUDGET_MS);
+  SCHEDULER.add("fetch", fetchTask, nullptr, FETCH_PERIOD_MS, FETCH_BUDGET_MS);
+  SCHEDULER.add("config", configWatchTask, nullptr, CONFIG_WATCH_MS, CONFIG_WATCH_BUDGET_MS, CONFIG_WATCH_MS);
+  SCHEDULER.add("telemetry", telemetryTask, nullptr, TELEMETRY_MS, TELEMETRY_BUDGET_MS, TELEMETRY_MS);
 }
 
 void loop(void) { 
-  if (LOOP_STATE.cyclesSinceRequest >= IDLE_CYCLES) {
-    std::vector<int> result(3 ,0);
-    int stops = client.getNextStops(result.begin(), result.end());
-    
-    if (stops == 0) {
-      Serial.printf("No new stops, skipping\n");
-      delay(1000);
-      return;
-    }
-
-    LOOP_STATE.cyclesSinceRequest = 0;
-    for (int i = 0; i < stops; i++) {
-      Serial.printf("In: %d minutes\n", result[i]);
-    }
-
-    if (result != LOOP_STATE.currentNextStops) {
-      LOOP_STATE.reset(result);
-      Serial.printf("Update next stops");
-    }
-  }
-
-  for (int i=0; i<NUM_LEDS; i++){
-    leds[i] = CRGB::Black;
-  }
-
-  int col = 0;
-
-  ////////  Line  ////////
-  col = drawSymbol(col, symbol::SymbolArray {
-    symbol::ONE_TRAIN,
-    symbol::SPACE
-  }, CRGB::Green, 0);
-
-
-  ////////  Direction  ////////
-  col = drawSymbol(col, symbol::SymbolArray {
-    (LOOP_STATE.stop.direction == config::Direction::South) ? symbol::ARROW_DOWN : symbol::ARROW_UP,
-    symbol::SPACE
-  }, CRGB::Yellow, 0);
-
-  ////////  Minutes  ////////
-  int minutesStartCol = col;
-  col = drawSymbol(col, LOOP_STATE.syms, CRGB::Red, LOOP_STATE.region_offset, minutesStartCol);
-
-  FastLED.show();
-  FastLED.delay(800);
-  LOOP_STATE.inc();
+  unsigned long idle = SCHEDULER.tick();
+  // Sleeping until the next task is due also yields to the WiFi stack
+  delay(std::min<unsigned long>(idle, FETCH_PERIOD_MS));
 }
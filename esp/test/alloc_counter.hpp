@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+
+namespace alloc_counter {
+
+// Number of calls to the global operator new since the program started
+std::size_t allocations();
+
+// Counts the allocations made during its lifetime
+class scope {
+    std::size_t _start;
+
+    public:
+    scope() : _start(allocations()) {}
+    std::size_t count() const { return allocations() - _start; }
+};
+
+}
@@ -0,0 +1,21 @@
+#include "arrivals_encoder.hpp"
+
+using namespace next_stop;
+
+template <class T>
+static void put_le(std::vector<uint8_t>& out, T value) {
+    for (std::size_t i = 0; i < sizeof(T); i++) out.push_back(static_cast<uint8_t>(uint64_t(value) >> (8 * i)));
+}
+
+std::vector<uint8_t> encode_arrivals(int64_t sample_ts, const std::vector<wire::arrival_record>& records) {
+    std::vector<uint8_t> out = {'N', 'S', wire::version, wire::record_size};
+    put_le<uint32_t>(out, records.size());
+    put_le<int64_t>(out, sample_ts);
+    for (const auto& r : records) {
+        put_le<int64_t>(out, r.arriving_at);
+        put_le<int64_t>(out, r.leaving_at);
+        put_le<uint16_t>(out, r.direction_id);
+        put_le<uint16_t>(out, r.line_id);
+    }
+    return out;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <NextStopClient.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Encodes arrivals in the binary wire format (see next_stop::wire), as the server sends them
+std::vector<uint8_t> encode_arrivals(int64_t sample_ts, const std::vector<next_stop::wire::arrival_record>& records);
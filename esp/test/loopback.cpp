@@ -0,0 +1,124 @@
+#include "loopback.hpp"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <stdexcept>
+
+namespace loopback {
+
+static sockaddr_in local(uint16_t port) {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    return addr;
+}
+
+// Reads one request: everything up to the blank line ending its headers. Empty once the peer closed.
+static std::string read_request(int fd) {
+    std::string request;
+    char c;
+    while (request.size() < 4 || request.compare(request.size() - 4, 4, "\r\n\r\n") != 0) {
+        if (::recv(fd, &c, 1, 0) != 1) return std::string();
+        request += c;
+    }
+    return request;
+}
+
+server::server(responder respond, int connections, bool keep_alive) {
+    _listener = ::socket(AF_INET, SOCK_STREAM, 0);
+    auto addr = local(0);
+    socklen_t length = sizeof(addr);
+    if (_listener < 0 || ::bind(_listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::listen(_listener, 1) != 0 || ::getsockname(_listener, reinterpret_cast<sockaddr*>(&addr), &length) != 0) {
+        throw std::runtime_error("loopback: unable to listen");
+    }
+    _port = ntohs(addr.sin_port);
+
+    _thread = std::thread([this, respond, connections, keep_alive]() {
+        for (int i = 0; i < connections; i++) {
+            int fd = ::accept(_listener, nullptr, nullptr);
+            if (fd < 0) return;
+
+            std::string request;
+            while (!(request = read_request(fd)).empty()) {
+                auto response = respond(request);
+                ::send(fd, response.data(), response.size(), MSG_NOSIGNAL);
+                if (!keep_alive) break;
+            }
+            ::close(fd);
+        }
+    });
+}
+
+server::~server() {
+    ::shutdown(_listener, SHUT_RDWR);
+    ::close(_listener);
+    _thread.join();
+}
+
+std::string server::url(const std::string& path) const {
+    return "http://127.0.0.1:" + std::to_string(_port) + path;
+}
+
+int socket::connect(const char* host, uint16_t port) {
+    stop();
+    _fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    auto addr = local(port);
+    if (_fd < 0 || ::inet_pton(AF_INET, host, &addr.sin_addr) != 1 ||
+        ::connect(_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        stop();
+        return 0;
+    }
+    ::fcntl(_fd, F_SETFL, ::fcntl(_fd, F_GETFL) | O_NONBLOCK);
+    _eof = false;
+    connects++;
+    return 1;
+}
+
+std::size_t socket::write(const uint8_t* data, std::size_t length) {
+    if (_fd < 0) return 0;
+    auto sent = ::send(_fd, data, length, MSG_NOSIGNAL);
+    return sent < 0 ? 0 : std::size_t(sent);
+}
+
+int socket::available() {
+    if (_fd < 0) return 0;
+    int pending = 0;
+    ::ioctl(_fd, FIONREAD, &pending);
+    if (pending == 0 && !_eof) {
+        // FIONREAD doesn't tell a closed peer from a quiet one
+        char c;
+        auto peeked = ::recv(_fd, &c, 1, MSG_PEEK);
+        _eof = peeked == 0 || (peeked < 0 && errno != EAGAIN && errno != EWOULDBLOCK);
+    }
+    return pending;
+}
+
+int socket::read(uint8_t* buffer, std::size_t length) {
+    if (_fd < 0) return 0;
+    auto got = ::recv(_fd, buffer, length, 0);
+    if (got == 0) _eof = true;
+    return got < 0 ? 0 : int(got);
+}
+
+uint8_t socket::connected() {
+    if (_fd < 0) return 0;
+    available();
+    return !_eof;
+}
+
+void socket::stop() {
+    if (_fd >= 0) ::close(_fd);
+    _fd = -1;
+    _eof = false;
+}
+
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+
+// A local TCP stand-in for the arrivals server, and a socket with WiFiClient's non-blocking
+// subset over POSIX sockets, so the HTTP code can be tested on the native env.
+namespace loopback {
+
+// Serves `connections` connections on 127.0.0.1, one at a time. For every request read on a
+// connection, `respond` returns the raw response to write; the connection is closed after it
+// unless keep_alive is set.
+class server {
+    int _listener;
+    uint16_t _port;
+    std::thread _thread;
+
+    public:
+    using responder = std::function<std::string(const std::string& request)>;
+
+    server(responder respond, int connections = 1, bool keep_alive = false);
+    ~server();
+
+    uint16_t port() const { return _port; }
+    std::string url(const std::string& path) const;
+};
+
+class socket {
+    int _fd = -1;
+    bool _eof = false;
+
+    public:
+    int connects = 0;
+
+    socket() = default;
+    socket(const socket&) = delete;
+    ~socket() { stop(); }
+
+    int connect(const char* host, uint16_t port);
+    std::size_t write(const uint8_t* data, std::size_t length);
+    int available();
+    int read(uint8_t* buffer, std::size_t length);
+    uint8_t connected();
+    void stop();
+};
+
+}
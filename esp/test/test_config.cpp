@@ -46,3 +46,32 @@ TEST(ParseConfig, ShouldPass) {
     EXPECT_EQ(result.connection.password, "password");
     
 }
+
+TEST(ParseConfigMalformed, ShouldPass) {
+    Config result;
+
+    EXPECT_EQ(parse("", &result), false);
+    EXPECT_EQ(parse("[1, 2]", &result), false);
+    EXPECT_EQ(parse(R"({"active_stop": 1)", &result), false);
+    // active_stop out of range
+    EXPECT_EQ(parse(R"({"active_stop": 2, "connection": {"ssid": "a", "password": "b"},
+        "stops": [{"direction": "South", "url": "u"}]})", &result), false);
+    EXPECT_EQ(parse(R"({"active_stop": -1, "connection": {"ssid": "a", "password": "b"},
+        "stops": [{"direction": "South", "url": "u"}]})", &result), false);
+    // wrong types
+    EXPECT_EQ(parse(R"({"active_stop": 0, "connection": {"ssid": 1, "password": "b"},
+        "stops": [{"direction": "South", "url": "u"}]})", &result), false);
+    EXPECT_EQ(parse(R"({"active_stop": 0, "connection": {"ssid": "a", "password": "b"},
+        "stops": [{"direction": "South"}]})", &result), false);
+    EXPECT_EQ(parse(R"({"active_stop": 0, "connection": {"ssid": "a", "password": "b"},
+        "stops": "url"})", &result), false);
+}
+
+TEST(ParseConfigUnknownDirection, ShouldPass) {
+    Config result;
+
+    EXPECT_EQ(parse(R"({"active_stop": 0, "connection": {"ssid": "a", "password": "b"},
+        "stops": [{"direction": "East", "url": "u"}]})", &result), true);
+    ASSERT_EQ(result.stops.size(), 1);
+    EXPECT_EQ(result.stops[0].direction, Direction::Unknown);
+}
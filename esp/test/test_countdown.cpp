@@ -0,0 +1,73 @@
+#include <gtest/gtest.h>
+#include <Countdown.hpp>
+
+#include <limits>
+
+using namespace next_stop;
+
+const timestamp_t sample = 1674785282;
+
+TEST(CountdownTest, ShouldPass) {
+    countdown<4> arrivals;
+    int minutes[3] = {};
+    EXPECT_EQ(arrivals.minutes(0, minutes, 3), 0);
+
+    // Out of order, and more than fit
+    timestamp_t fetched[] = {sample + 600, sample + 90, sample + 30, sample + 1200, sample + 300};
+    arrivals.assign(fetched, 5);
+    arrivals.sync(sample, 50000);
+    ASSERT_EQ(arrivals.size(), 4);
+    EXPECT_EQ(arrivals[0], sample + 30);
+    EXPECT_EQ(arrivals[3], sample + 600);
+
+    ASSERT_EQ(arrivals.minutes(50000, minutes, 3), 3);
+    EXPECT_EQ(minutes[0], 0);
+    EXPECT_EQ(minutes[1], 1);
+    EXPECT_EQ(minutes[2], 5);
+
+    // Two minutes later, without a poll
+    ASSERT_EQ(arrivals.minutes(50000 + 120000, minutes, 3), 2);
+    EXPECT_EQ(arrivals.size(), 2);
+    EXPECT_EQ(minutes[0], 3);
+    EXPECT_EQ(minutes[1], 8);
+
+    // A train is shown until its arrival time has passed
+    EXPECT_EQ(arrivals.minutes(50000 + 300000, minutes, 3), 2);
+    EXPECT_EQ(minutes[0], 0);
+    EXPECT_EQ(arrivals.minutes(50000 + 301000, minutes, 3), 1);
+
+    EXPECT_EQ(arrivals.minutes(50000 + 601000, minutes, 3), 0);
+    EXPECT_TRUE(arrivals.empty());
+}
+
+TEST(CountdownSyncTest, ShouldPass) {
+    countdown<3> arrivals;
+    timestamp_t fetched[] = {sample + 600};
+    arrivals.assign(fetched, 1);
+    int minutes[1];
+
+    // The device clock runs ahead of the server's by an arbitrary offset
+    arrivals.sync(sample - 60, 1000);
+    arrivals.minutes(1000, minutes, 1);
+    EXPECT_EQ(minutes[0], 11);
+
+    arrivals.sync(sample, 2000);
+    EXPECT_EQ(arrivals.server_time(2000), sample);
+    arrivals.minutes(2000, minutes, 1);
+    EXPECT_EQ(minutes[0], 10);
+}
+
+TEST(CountdownWraparoundTest, ShouldPass) {
+    countdown<3> arrivals;
+    timestamp_t fetched[] = {sample + 180};
+    arrivals.assign(fetched, 1);
+
+    // millis() wraps between the sync and the frame
+    unsigned long before = std::numeric_limits<unsigned long>::max() - 29999;
+    arrivals.sync(sample, before);
+    EXPECT_EQ(arrivals.server_time(before + 90000), sample + 90);
+
+    int minutes[1];
+    ASSERT_EQ(arrivals.minutes(before + 90000, minutes, 1), 1);
+    EXPECT_EQ(minutes[0], 1);
+}
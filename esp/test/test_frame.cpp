@@ -0,0 +1,174 @@
+#include <gtest/gtest.h>
+#include <Frame.hpp>
+
+#include <vector>
+
+#include "alloc_counter.hpp"
+
+using frame::DirtyColumns;
+
+struct written {
+    std::size_t col;
+    uint8_t bits;
+    int color;
+
+    bool operator==(const written& rhs) const {
+        return col == rhs.col && bits == rhs.bits && color == rhs.color;
+    }
+};
+
+template <std::size_t Cols>
+std::vector<written> flush(DirtyColumns<int, Cols>& frame) {
+    std::vector<written> result;
+    frame.flush([&](std::size_t col, uint8_t bits, int color) { result.push_back({col, bits, color}); });
+    return result;
+}
+
+TEST(DirtyColumnsFirstFlushWritesAll, ShouldPass) {
+    DirtyColumns<int, 4> frame;
+    frame.clear();
+    frame.draw(1, 0b101, 7);
+
+    auto w = flush(frame);
+    ASSERT_EQ(w.size(), 4);
+    EXPECT_EQ(w[0], (written{0, 0, 0}));
+    EXPECT_EQ(w[1], (written{1, 0b101, 7}));
+}
+
+TEST(DirtyColumnsUnchangedFrame, ShouldPass) {
+    DirtyColumns<int, 4> frame;
+    frame.draw(1, 0b101, 7);
+    flush(frame);
+
+    frame.clear();
+    frame.draw(1, 0b101, 7);
+    EXPECT_TRUE(flush(frame).empty());
+
+    // Out of range columns don't dirty the frame
+    frame.draw(4, 0xFF, 1);
+    EXPECT_TRUE(flush(frame).empty());
+}
+
+TEST(DirtyColumnsOnlyChanged, ShouldPass) {
+    DirtyColumns<int, 4> frame;
+    frame.draw(0, 0b1, 1);
+    frame.draw(3, 0b1, 1);
+    flush(frame);
+
+    frame.clear();
+    frame.draw(0, 0b1, 2);  // color changed
+    frame.draw(2, 0b1, 1);  // newly lit
+                            // column 3 went dark
+    auto w = flush(frame);
+    ASSERT_EQ(w.size(), 3);
+    EXPECT_EQ(w[0], (written{0, 0b1, 2}));
+    EXPECT_EQ(w[1], (written{2, 0b1, 1}));
+    EXPECT_EQ(w[2], (written{3, 0, 0}));
+}
+
+TEST(DirtyColumnsBlankIgnoresColor, ShouldPass) {
+    DirtyColumns<int, 2> frame;
+    frame.draw(0, 0, 3);
+    flush(frame);
+
+    frame.draw(0, 0, 5);
+    EXPECT_TRUE(flush(frame).empty());
+
+    frame.invalidate();
+    EXPECT_EQ(flush(frame).size(), 2);
+}
+
+TEST(DirtyColumnsNoAlloc, ShouldPass) {
+    DirtyColumns<int, 32> frame;
+    std::size_t writes = 0;
+
+    alloc_counter::scope allocations;
+    for (int f = 0; f < 10; f++) {
+        frame.clear();
+        frame.draw(f % 32, 0xFF, 1);
+        writes += frame.flush([](std::size_t, uint8_t, int) {});
+    }
+
+    EXPECT_EQ(allocations.count(), 0);
+    EXPECT_EQ(writes, 32 + 9 * 2);
+}
+
+using frame::panel_layout;
+using frame::rotation;
+
+// Every display pixel maps to a distinct LED
+void expectBijection(const panel_layout& layout) {
+    std::vector<bool> seen(layout.leds(), false);
+    for (std::size_t y = 0; y < layout.height(); y++) {
+        for (std::size_t x = 0; x < layout.width(); x++) {
+            auto led = layout.led(x, y);
+            ASSERT_LT(led, layout.leds()) << x << "," << y;
+            EXPECT_FALSE(seen[led]) << x << "," << y;
+            seen[led] = true;
+        }
+    }
+}
+
+TEST(PanelLayoutDefault, ShouldPass) {
+    // The original firmware's zigzag: column-major, odd columns run bottom to top
+    constexpr panel_layout layout = {32, 8};
+    constexpr frame::PixelMap<32, 8> pixels(layout);
+    static_assert(pixels(0, 0) == 0);
+    static_assert(pixels(1, 0) == 15);
+
+    EXPECT_EQ(layout.width(), 32);
+    EXPECT_EQ(layout.height(), 8);
+    for (std::size_t col = 0; col < 32; col++) {
+        for (std::size_t i = 0; i < 8; i++) {
+            std::size_t row = (col % 2) == 0 ? i : 7 - i;
+            EXPECT_EQ(pixels(col, row), col * 8 + i) << col << "," << i;
+        }
+    }
+}
+
+TEST(PanelLayoutChained, ShouldPass) {
+    panel_layout layout = {8, 8};
+    layout.panels_x = 2;
+    layout.panels_y = 2;
+
+    EXPECT_EQ(layout.width(), 16);
+    EXPECT_EQ(layout.height(), 16);
+    EXPECT_EQ(layout.led(8, 0), 64);
+    EXPECT_EQ(layout.led(0, 8), 128);
+    EXPECT_EQ(layout.led(15, 15), 255 - 7);
+    expectBijection(layout);
+}
+
+TEST(PanelLayoutStrips, ShouldPass) {
+    panel_layout layout = {4, 2};
+    layout.column_major = false;
+    layout.serpentine = false;
+    EXPECT_EQ(layout.led(3, 0), 3);
+    EXPECT_EQ(layout.led(0, 1), 4);
+
+    layout.serpentine = true;
+    EXPECT_EQ(layout.led(0, 1), 7);
+
+    layout.reversed = true;
+    EXPECT_EQ(layout.led(0, 0), 3);
+    EXPECT_EQ(layout.led(0, 1), 4);
+    expectBijection(layout);
+}
+
+TEST(PanelLayoutRotation, ShouldPass) {
+    panel_layout layout = {32, 8};
+
+    layout.rotate = rotation::cw180;
+    EXPECT_EQ(layout.led(31, 7), 0);
+    expectBijection(layout);
+
+    layout.rotate = rotation::cw90;
+    EXPECT_EQ(layout.width(), 8);
+    EXPECT_EQ(layout.height(), 32);
+    EXPECT_EQ(layout.led(7, 0), 0);
+    expectBijection(layout);
+
+    layout.rotate = rotation::cw270;
+    EXPECT_EQ(layout.led(0, 31), 0);
+    expectBijection(layout);
+}
@@ -1,6 +1,9 @@
 #include <gtest/gtest.h>
 #include <NextStopClient.hpp>
 
+#include "alloc_counter.hpp"
+#include "arrivals_encoder.hpp"
+
 using namespace next_stop;
 
 const auto s = R"([
@@ -57,3 +60,406 @@ TEST(NextStopClientTest, ShouldPass) {
         std::cout << x << "\n";
     }
 }
+
+TEST(ParseSaxSkipsUnrequestedTest, ShouldPass) {
+    const auto body = R"([
+        {"stop": {"name": "116 St", "ids": [1, 2]}, "arriving_at_timestamp": 10, "extra": [[]]},
+        {"arriving_at_timestamp": 20, "stop": null}
+    ])";
+
+    auto result = parse(body, argument<int64_t>("arriving_at_timestamp"));
+    EXPECT_EQ(result, (std::vector<std::tuple<int64_t>>{{10}, {20}}));
+}
+
+TEST(ParseSaxLongerTest, ShouldPass) {
+    auto result = parse(longer, argument<std::string>("direction"),
+        argument<int64_t>("arriving_at_timestamp")
+    );
+
+    EXPECT_EQ(result.size(), 6);
+    EXPECT_EQ(std::get<0>(result[1]), "117S");
+    EXPECT_EQ(std::get<1>(result[5]), 1674786125);
+}
+
+TEST(ParseSaxErrorsTest, ShouldPass) {
+    EXPECT_THROW(parse(R"([{"arriving_at_timestamp": 1)", argument<int64_t>("arriving_at_timestamp")),
+        std::invalid_argument);
+    EXPECT_THROW(parse(R"([{"stop": "x"}])", argument<int64_t>("arriving_at_timestamp")),
+        std::invalid_argument);
+    EXPECT_THROW(parse(R"([{"arriving_at_timestamp": "1"}])", argument<int64_t>("arriving_at_timestamp")),
+        std::invalid_argument);
+}
+
+template <class... Ts>
+struct collect_sink {
+    std::vector<std::tuple<Ts...>>& result;
+    bool operator()(const std::tuple<Ts...>& values) const {
+        result.push_back(values);
+        return true;
+    }
+};
+
+template <class... Ts>
+sax_status parse_chunks(const std::string& body, std::size_t split, std::size_t chunk_size,
+    std::vector<std::tuple<Ts...>>& result, const argument<Ts>&... args) {
+    element_stream<collect_sink<Ts...>, Ts...> stream(collect_sink<Ts...>{result}, args...);
+
+    auto status = stream.feed(body.data(), split);
+    for (std::size_t i = split; i < body.size() && status == sax_status::ok; i += chunk_size) {
+        status = stream.feed(body.data() + i, std::min(chunk_size, body.size() - i));
+    }
+    return stream.finish();
+}
+
+TEST(ChunkedParseEveryBoundaryTest, ShouldPass) {
+    const std::string escaped = R"( [ {"direction": "11\"7\\Né🚆", "arriving_at_timestamp": -12,
+        "leaving_at_timestamp": 1.5e3, "flags": [true, false, null, {}], "line": "1"} ] )";
+
+    for (const std::string& body : {std::string(s), std::string(longer), escaped}) {
+        auto expected = parse(body, argument<std::string>("direction"),
+            argument<int64_t>("arriving_at_timestamp"));
+
+        for (std::size_t split = 0; split <= body.size(); split++) {
+            std::vector<std::tuple<std::string, int64_t>> result;
+            auto status = parse_chunks(body, split, body.size(), result,
+                argument<std::string>("direction"), argument<int64_t>("arriving_at_timestamp"));
+
+            EXPECT_EQ(status, sax_status::ok) << "split at " << split;
+            EXPECT_EQ(result, expected) << "split at " << split;
+        }
+
+        std::vector<std::tuple<std::string, int64_t>> result;
+        EXPECT_EQ(parse_chunks(body, 0, 1, result, argument<std::string>("direction"),
+            argument<int64_t>("arriving_at_timestamp")), sax_status::ok);
+        EXPECT_EQ(result, expected);
+    }
+}
+
+TEST(ChunkedParseEscapesTest, ShouldPass) {
+    std::vector<std::tuple<std::string, double>> result;
+    auto status = parse_chunks(R"([{"direction": "a\"\\\/\né🚆", "n": 1.5e3}])", 0, 3, result,
+        argument<std::string>("direction"), argument<double>("n"));
+
+    EXPECT_EQ(status, sax_status::ok);
+    ASSERT_EQ(result.size(), 1);
+    EXPECT_EQ(std::get<0>(result[0]), "a\"\\/\n\xc3\xa9\xf0\x9f\x9a\x86");
+    EXPECT_EQ(std::get<1>(result[0]), 1500.0);
+}
+
+TEST(ChunkedParseErrorsTest, ShouldPass) {
+    const std::string body(longer);
+    for (std::size_t cut = 0; cut < body.size(); cut++) {
+        std::vector<std::tuple<int64_t>> result;
+        EXPECT_NE(parse_chunks(body.substr(0, cut), 0, 7, result, argument<int64_t>("arriving_at_timestamp")),
+            sax_status::ok) << "cut at " << cut;
+    }
+
+    std::vector<std::tuple<int64_t>> result;
+    EXPECT_EQ(parse_chunks("[{\"a\": tru}]", 0, 1, result, argument<int64_t>("a")), sax_status::syntax_error);
+    EXPECT_EQ(parse_chunks("[{\"a\": 1}] x", 0, 1, result, argument<int64_t>("a")), sax_status::syntax_error);
+    EXPECT_EQ(parse_chunks("[{\"a\": 1]", 0, 1, result, argument<int64_t>("a")), sax_status::syntax_error);
+    EXPECT_EQ(parse_chunks("[{\"a\": \"1\"}]", 0, 1, result, argument<int64_t>("a")), sax_status::wrong_type);
+    EXPECT_EQ(parse_chunks("[{\"b\": 1}]", 0, 1, result, argument<int64_t>("a")), sax_status::missing_key);
+    EXPECT_EQ(parse_chunks(std::string(80, '['), 0, 1, result, argument<int64_t>("a")), sax_status::too_large);
+
+    // Numbers outside the JSON grammar, which the nlohmann path rejects as well
+    std::vector<std::tuple<double>> numbers;
+    for (auto number : {"01", "-01", "00", "-", "1.", "-1.", ".5", "1.e3", "1e", "1E+", "1e-", "+1", "1.5.2",
+                        "1e5e5", "1e5.0", "1-2", "--1"}) {
+        std::string body = std::string("[{\"a\": ") + number + "}]";
+        EXPECT_EQ(parse_chunks(body, 0, 1, numbers, argument<double>("a")), sax_status::syntax_error) << number;
+        EXPECT_THROW(parse(body, argument<double>("a")), std::invalid_argument) << number;
+    }
+    for (auto number : {"0", "-0", "10", "0.5", "-0.5e-3", "1E+2", "1e2", "0e0"}) {
+        std::string body = std::string("[{\"a\": ") + number + "}]";
+        numbers.clear();
+        EXPECT_EQ(parse_chunks(body, 0, 1, numbers, argument<double>("a")), sax_status::ok) << number;
+        EXPECT_EQ(numbers, parse(body, argument<double>("a"))) << number;
+    }
+    // A top level number only ends with the body
+    EXPECT_EQ(parse_chunks("1.", 0, 1, result, argument<int64_t>("a")), sax_status::syntax_error);
+}
+
+TEST(ChunkedParseSkipsLongStringsTest, ShouldPass) {
+    const std::string body = "[{\"stop\": \"" + std::string(500, 'x') + "\", \"" + std::string(100, 'k')
+        + "\": 1, \"arriving_at_timestamp\": 42}]";
+
+    std::vector<std::tuple<int64_t>> result;
+    EXPECT_EQ(parse_chunks(body, 0, 16, result, argument<int64_t>("arriving_at_timestamp")), sax_status::ok);
+    EXPECT_EQ(result, (std::vector<std::tuple<int64_t>>{{42}}));
+}
+
+TEST(NextMinutesStreamTest, ShouldPass) {
+    std::vector<int> minutes;
+    auto stream = make_next_minutes_stream(1674785282, minutes);
+
+    const std::string body(longer);
+    for (std::size_t i = 0; i < body.size(); i += 5) {
+        stream.feed(body.data() + i, std::min<std::size_t>(5, body.size() - i));
+    }
+
+    EXPECT_EQ(stream.finish(), sax_status::ok);
+    EXPECT_EQ(minutes, next_minutes("1674785282", longer));
+}
+
+TEST(NextMinutesOutputIteratorTest, ShouldPass) {
+    int minutes[3] = {-1, -1, -1};
+
+    EXPECT_EQ(next_minutes("1674698100", s, minutes, 3), 1);
+    EXPECT_EQ(minutes[0], (1674701221 - 1674698100) / 60);
+    EXPECT_EQ(minutes[1], -1);
+
+    auto all = next_minutes("1674785282", longer);
+    EXPECT_EQ(next_minutes("1674785282", longer, minutes, 3), 3);
+    EXPECT_EQ(std::vector<int>(minutes, minutes + 3), std::vector<int>(all.begin(), all.begin() + 3));
+
+    EXPECT_EQ(next_minutes("1674785282", longer, minutes, 0), 0);
+    EXPECT_EQ(next_minutes("1674785282", "[{\"arriving_at_timestamp\": ", minutes, 3), 0);
+}
+
+TEST(NextMinutesNoAllocationTest, ShouldPass) {
+    const std::string body(longer);
+    std::array<int, 3> minutes;
+    std::vector<int> result(3, 0);
+
+    alloc_counter::scope allocations;
+
+    EXPECT_EQ(next_minutes("1674785282", longer, minutes.begin(), minutes.size()), 3);
+    EXPECT_EQ(next_minutes("1674785282", body, result.begin(), result.size()), 3);
+
+    auto stream = make_next_minutes_stream(1674785282, minutes.begin(), minutes.size());
+    for (std::size_t i = 0; i < body.size(); i += 16) {
+        stream.feed(body.data() + i, std::min<std::size_t>(16, body.size() - i));
+    }
+    EXPECT_EQ(stream.finish(), sax_status::stopped);
+    EXPECT_EQ(stream.sink().count, 3);
+
+    EXPECT_EQ(allocations.count(), 0);
+
+    // The counter is live: the vector returning overload does allocate
+    alloc_counter::scope vector_allocations;
+    next_minutes("1674785282", longer);
+    EXPECT_GT(vector_allocations.count(), 0);
+}
+
+// `longer` shuffled, with an entry that already departed
+const auto unsorted = R"([{"direction":"117S","arriving_at_timestamp":1674786125},{"direction":"117N","arriving_at_timestamp":1674785753},{"direction":"117N","arriving_at_timestamp":1674785100},{"direction":"117S","arriving_at_timestamp":1674785674},{"direction":"117N","arriving_at_timestamp":1674786007},{"direction":"117S","arriving_at_timestamp":1674785891},{"direction":"117N","arriving_at_timestamp":1674785619}])";
+
+TEST(TopKSortedTest, ShouldPass) {
+    std::array<arrival_t, 2> arrivals;
+    int visited = 0;
+
+    auto found = top_k(longer, arrivals.begin(), arrivals.size(), order::sorted,
+        [&visited](const arrival_t& arrival) { visited++; return std::get<1>(arrival) == "117S"; },
+        argument<timestamp_t>("arriving_at_timestamp"), argument<std::string>("direction"));
+
+    EXPECT_EQ(found, 2);
+    EXPECT_EQ(std::get<0>(arrivals[0]), 1674785674);
+    EXPECT_EQ(std::get<0>(arrivals[1]), 1674785891);
+    // Stopped right after the 2nd match, the 4th of 6 elements
+    EXPECT_EQ(visited, 4);
+}
+
+TEST(TopKUnsortedTest, ShouldPass) {
+    std::array<arrival_t, 3> arrivals;
+
+    auto found = top_k(unsorted, arrivals.begin(), arrivals.size(), order::unsorted,
+        match_all(future_only{1674785282}, direction_is{"117N"}),
+        argument<timestamp_t>("arriving_at_timestamp"), argument<std::string>("direction"));
+
+    EXPECT_EQ(found, 3);
+    EXPECT_EQ(std::get<0>(arrivals[0]), 1674785619);
+    EXPECT_EQ(std::get<0>(arrivals[1]), 1674785753);
+    EXPECT_EQ(std::get<0>(arrivals[2]), 1674786007);
+
+    // Fewer matches than K
+    EXPECT_EQ(top_k(unsorted, arrivals.begin(), arrivals.size(), order::unsorted,
+        direction_is{"117X"},
+        argument<timestamp_t>("arriving_at_timestamp"), argument<std::string>("direction")), 0);
+}
+
+TEST(NextMinutesTopKTest, ShouldPass) {
+    int minutes[3];
+
+    alloc_counter::scope allocations;
+    auto found = next_minutes_top_k<3>("1674785282", unsorted, minutes, future_only{1674785282}, order::unsorted);
+    EXPECT_EQ(allocations.count(), 0);
+
+    EXPECT_EQ(found, 3);
+    EXPECT_EQ(std::vector<int>(minutes, minutes + 3), std::vector<int>({
+        (1674785619 - 1674785282) / 60, (1674785674 - 1674785282) / 60, (1674785753 - 1674785282) / 60
+    }));
+
+    EXPECT_EQ(next_minutes_top_k<3>("1674785282", longer, minutes, direction_is{"117S"}), 3);
+    // Nothing against epoch 0 for a bad header
+    EXPECT_EQ(next_minutes_top_k<3>("", longer, minutes, direction_is{"117S"}), 0);
+    EXPECT_EQ(next_minutes_top_k<3>("16747x", longer, minutes, direction_is{"117S"}), 0);
+    EXPECT_EQ(minutes[2], (1674786125 - 1674785282) / 60);
+}
+
+static_assert(arriving_at_schema.find("arriving_at_timestamp") == 0, "resolved at compile time");
+static_assert(arrival_schema.find("direction") == 1, "resolved at compile time");
+static_assert(arrival_schema.find("leaving_at_timestamp") == arrival_schema.npos, "not requested");
+
+TEST(KeySchemaTest, ShouldPass) {
+    EXPECT_TRUE(arriving_at_schema.perfect());
+    EXPECT_TRUE(arrival_schema.perfect());
+
+    // Same length and first/last characters
+    constexpr key_schema<int, int, int, int> similar(argument<int>("a1z"), argument<int>("a2z"),
+        argument<int>("a3z"), argument<int>("a4z"));
+    EXPECT_EQ(similar.find("a1z"), 0);
+    EXPECT_EQ(similar.find("a2z"), 1);
+    EXPECT_EQ(similar.find("a3z"), 2);
+    EXPECT_EQ(similar.find("a4z"), 3);
+    EXPECT_EQ(similar.find("a5z"), similar.npos);
+    EXPECT_EQ(similar.find(""), similar.npos);
+
+    for (auto key : {"stop", "line", "direction", "leaving_at_timestamp", "arriving_at_timestamp_", ""}) {
+        EXPECT_EQ(arriving_at_schema.find(key), arriving_at_schema.npos) << key;
+    }
+}
+
+const char* const many_keys[32] = {"k0", "k1", "k2", "k3", "k4", "k5", "k6", "k7", "k8", "k9", "k10",
+    "k11", "k12", "k13", "k14", "k15", "k16", "k17", "k18", "k19", "k20", "k21", "k22", "k23", "k24", "k25",
+    "k26", "k27", "k28", "k29", "k30", "k31"};
+
+template <std::size_t... Is>
+sax_status for_each_many_keys(const std::string& body, std::size_t& elements, std::index_sequence<Is...>) {
+    return for_each_element(body, [&](const auto&) { return ++elements, true; },
+        argument<int64_t>(many_keys[Is])...);
+}
+
+// The most keys one element can be matched against
+TEST(ParseSaxMostKeysTest, ShouldPass) {
+    std::string body = "[{";
+    for (int i = 0; i < 32; i++) body += std::string(i ? ", " : "") + "\"k" + std::to_string(i) + "\": " + std::to_string(i);
+    body += "}]";
+
+    std::size_t elements = 0;
+    EXPECT_EQ(for_each_many_keys(body, elements, std::make_index_sequence<32>()), sax_status::ok);
+    EXPECT_EQ(elements, 1);
+
+    // Without the last one
+    body.replace(body.find("\"k31\""), 5, "\"x31\"");
+    EXPECT_EQ(for_each_many_keys(body, elements, std::make_index_sequence<32>()), sax_status::missing_key);
+}
+
+TEST(KeySchemaManyUnrelatedKeysTest, ShouldPass) {
+    std::string body = "[{";
+    for (int i = 0; i < 200; i++) body += "\"key" + std::to_string(i) + "\": " + std::to_string(i) + ", ";
+    body += "\"direction\": \"117N\", \"arriving_at_timestamp\": 7}]";
+
+    std::array<arrival_t, 1> arrivals;
+    EXPECT_EQ(top_k(body, arrivals.begin(), 1, order::sorted, future_only{0}, arrival_schema), 1);
+    EXPECT_EQ(arrivals[0], arrival_t(7, "117N"));
+}
+
+TEST(TryParseTimestampTest, ShouldPass) {
+    EXPECT_EQ(try_parse_timestamp("1674698100").value(), 1674698100);
+    EXPECT_EQ(try_parse_timestamp("").error(), error_code::bad_header);
+    EXPECT_EQ(try_parse_timestamp("16746x").error(), error_code::bad_header);
+    EXPECT_EQ(try_parse_timestamp("99999999999999999999").error(), error_code::bad_header);
+    EXPECT_EQ(parse_timestamp(""), 0);
+}
+
+TEST(TryNextMinutesErrorsTest, ShouldPass) {
+    int minutes[3];
+
+    auto ok = try_next_minutes("1674785282", longer, minutes, 3);
+    ASSERT_TRUE(ok);
+    EXPECT_EQ(ok.value(), 3);
+
+    EXPECT_EQ(try_next_minutes("", s, minutes, 3).error(), error_code::bad_header);
+    EXPECT_EQ(try_next_minutes("1674785282", "[{\"arriving_at_timestamp\": 1", minutes, 3).error(),
+        error_code::truncated_body);
+    EXPECT_EQ(try_next_minutes("1674785282", "[{\"arriving_at_timestamp\": 1]", minutes, 3).error(),
+        error_code::malformed_body);
+    EXPECT_EQ(try_next_minutes("1674785282", "[{\"arriving_at_timestamp\": \"1\"}]", minutes, 3).error(),
+        error_code::wrong_type);
+    EXPECT_EQ(try_next_minutes("1674785282", "[{\"leaving_at_timestamp\": 1}]", minutes, 3).error(),
+        error_code::missing_key);
+
+    EXPECT_THROW(next_minutes("", s), std::invalid_argument);
+}
+
+TEST(AssignValueRangeTest, ShouldPass) {
+    int64_t slot = 7;
+    EXPECT_FALSE(assign_value(slot, 1e300));
+    EXPECT_FALSE(assign_value(slot, -1e300));
+    EXPECT_FALSE(assign_value(slot, 1.5));
+    EXPECT_FALSE(assign_value(slot, std::numeric_limits<double>::infinity()));
+    EXPECT_FALSE(assign_value(slot, std::numeric_limits<double>::quiet_NaN()));
+    EXPECT_FALSE(assign_value(slot, uint64_t(std::numeric_limits<int64_t>::max()) + 1));
+    // Rejected values leave the slot untouched
+    EXPECT_EQ(slot, 7);
+
+    EXPECT_TRUE(assign_value(slot, 1674785282.0));
+    EXPECT_EQ(slot, 1674785282);
+    EXPECT_TRUE(assign_value(slot, -9223372036854775808.0));
+    EXPECT_EQ(slot, std::numeric_limits<int64_t>::min());
+
+    int narrow = 0;
+    EXPECT_FALSE(assign_value(narrow, int64_t(1) << 40));
+    EXPECT_FALSE(assign_value(narrow, 1e10));
+    uint32_t unsigned_slot = 0;
+    EXPECT_FALSE(assign_value(unsigned_slot, int64_t(-1)));
+    EXPECT_FALSE(assign_value(unsigned_slot, -1.0));
+    EXPECT_EQ(unsigned_slot, 0);
+
+    int minutes[3];
+    for (const char* body : {"[{\"arriving_at_timestamp\": 1e300}]", "[{\"arriving_at_timestamp\": -1e300}]",
+                             "[{\"arriving_at_timestamp\": 1.5}]"}) {
+        EXPECT_EQ(try_next_minutes("1674785282", body, minutes, 3).error(), error_code::wrong_type) << body;
+    }
+}
+
+TEST(WireArrivalsViewTest, ShouldPass) {
+    auto body = encode_arrivals(1674785282, {
+        {1674785619, 1674785620, 2, '1'},
+        {1674785674, 1674785675, 1, 'G' | ('S' << 8)},
+        {-1, 0, 0, 0},
+    });
+    EXPECT_EQ(body.size(), wire::header_size + 3 * wire::record_size);
+
+    auto view = wire::arrivals_view::decode(body.data(), body.size());
+    ASSERT_TRUE(view);
+    EXPECT_EQ(view.value().sample_ts(), 1674785282);
+    EXPECT_EQ(view.value().size(), 3);
+    EXPECT_EQ(view.value()[0].arriving_at, 1674785619);
+    EXPECT_EQ(view.value()[0].direction_id, 2);
+    EXPECT_EQ(view.value()[1].leaving_at, 1674785675);
+    EXPECT_EQ(view.value()[1].line_id, 'G' | ('S' << 8));
+    EXPECT_EQ(view.value()[2].arriving_at, -1);
+
+    int minutes[2];
+    EXPECT_EQ(wire::next_minutes(view.value(), minutes, 2), 2);
+    EXPECT_EQ(minutes[0], (1674785619 - 1674785282) / 60);
+    EXPECT_EQ(minutes[1], (1674785674 - 1674785282) / 60);
+}
+
+TEST(WireArrivalsViewErrorsTest, ShouldPass) {
+    auto body = encode_arrivals(1, {{10, 10, 1, '1'}, {20, 20, 1, '1'}});
+
+    EXPECT_EQ(wire::arrivals_view::decode(body.data(), 10).error(), error_code::truncated_body);
+    EXPECT_EQ(wire::arrivals_view::decode(body.data(), body.size() - 1).error(), error_code::truncated_body);
+
+    auto partial = wire::arrivals_view::decode(body.data(), body.size() - 1, true);
+    ASSERT_TRUE(partial);
+    EXPECT_EQ(partial.value().size(), 1);
+
+    body[0] = '[';
+    EXPECT_EQ(wire::arrivals_view::decode(body.data(), body.size()).error(), error_code::malformed_body);
+}
+
+TEST(NextMinutesExtremeTimestampsTest, ShouldPass) {
+    // Found by fuzz/fuzz_next_stop.cpp: far-off timestamps overflowed the subtraction
+    const char* body = R"([{"arriving_at_timestamp": -9223372036854775808},
+                           {"arriving_at_timestamp": 9223372036854775807},
+                           {"arriving_at_timestamp": 1674785342}])";
+    int minutes[3];
+    EXPECT_EQ(next_minutes("1674785282", body, minutes, 3), 3);
+    EXPECT_EQ(minutes[0], std::numeric_limits<int>::min());
+    EXPECT_EQ(minutes[1], std::numeric_limits<int>::max());
+    EXPECT_EQ(minutes[2], 1);
+}
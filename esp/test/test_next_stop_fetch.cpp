@@ -0,0 +1,411 @@
+#include <gtest/gtest.h>
+#include <NextStopFetch.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "alloc_counter.hpp"
+#include "arrivals_encoder.hpp"
+#include "loopback.hpp"
+
+using namespace next_stop;
+
+// A server scripted in memory: the response arrives `piece` bytes at a time and the connection
+// closes once it has all been read, unless kept alive. A kept connection serves the response again
+// for every request.
+struct fake_socket {
+    bool accept = true;
+    std::string host;
+    uint16_t port = 0;
+    std::string request;
+    std::string response;
+    std::size_t served = 0;
+    std::size_t piece = 7;
+    std::size_t write_limit = std::numeric_limits<std::size_t>::max();
+    bool open = false;
+    int connects = 0;
+    bool keep_alive = false;
+    // The server closes the kept connection, which only shows once the next request is written
+    bool hang_up = false;
+    bool hung_up = false;
+
+    int connect(const char* h, uint16_t p) {
+        host = h;
+        port = p;
+        connects++;
+        open = accept;
+        served = 0;
+        hung_up = false;
+        return open;
+    }
+    std::size_t write(const uint8_t* data, std::size_t length) {
+        if (hang_up) hung_up = true, hang_up = false;
+        if (keep_alive && served == response.size()) served = 0;
+        length = std::min(length, write_limit);
+        request.append(reinterpret_cast<const char*>(data), length);
+        return length;
+    }
+    int available() { return open && !hung_up ? std::min(piece, response.size() - served) : 0; }
+    int read(uint8_t* buffer, std::size_t length) {
+        length = std::min<std::size_t>(length, available());
+        std::memcpy(buffer, response.data() + served, length);
+        served += length;
+        return length;
+    }
+    uint8_t connected() { return open && !hung_up && (keep_alive || served < response.size()); }
+    void stop() { open = false; }
+};
+
+using fake_fetcher = fetcher<fake_socket>;
+
+// Steps until the fetch ends, returning its status; `steps` counts the calls
+template <class F>
+typename F::status run(F& fetch, unsigned long now = 0, int* steps = nullptr) {
+    for (int i = 1; i < 10000000; i++) {
+        auto status = fetch.step(now);
+        if (status != F::status::busy) {
+            if (steps) *steps = i;
+            return status;
+        }
+    }
+    return F::status::busy;
+}
+
+const std::string arrivals = R"([{"arriving_at_timestamp":1674785619},{"arriving_at_timestamp":1674785674},{"arriving_at_timestamp":1674785753},{"arriving_at_timestamp":1674785891}])";
+
+std::string json_response(const std::string& body, const std::string& extra = "") {
+    return "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nx-timestamp: 1674785282\r\nContent-Length: " +
+        std::to_string(body.size()) + "\r\n" + extra + "\r\n" + body;
+}
+
+TEST(ParseUrlTest, ShouldPass) {
+    auto url = try_parse_url("http://example.com:8080/next_stop?stop=116");
+    ASSERT_TRUE(url);
+    EXPECT_EQ(url.value().host, "example.com");
+    EXPECT_EQ(url.value().port, 8080);
+    EXPECT_EQ(url.value().path, "/next_stop?stop=116");
+
+    url = try_parse_url("http://10.0.0.2");
+    ASSERT_TRUE(url);
+    EXPECT_EQ(url.value().port, 80);
+    EXPECT_EQ(url.value().path, "/");
+
+    EXPECT_EQ(try_parse_url("https://example.com/").error(), error_code::bad_url);
+    EXPECT_EQ(try_parse_url("http://:80/").error(), error_code::bad_url);
+    EXPECT_EQ(try_parse_url("http://host:0/").error(), error_code::bad_url);
+    EXPECT_EQ(try_parse_url("http://host:99999/").error(), error_code::bad_url);
+    EXPECT_EQ(try_parse_url("http://host:8o/").error(), error_code::bad_url);
+}
+
+TEST(FetchJsonTest, ShouldPass) {
+    fake_socket socket;
+    socket.response = json_response(arrivals);
+    fake_fetcher fetch(socket, 5000);
+    ASSERT_TRUE(fetch.set_url("http://example.com:8080/next_stop"));
+
+    timestamp_t arrived[3] = {};
+    int steps = 0;
+    // Keep the fake's own bookkeeping out of the count
+    socket.request.reserve(1024);
+    socket.host.reserve(64);
+    alloc_counter::scope allocations;
+    ASSERT_TRUE(fetch.start(arrived, 3, 0));
+    EXPECT_FALSE(fetch.start(arrived, 3, 0));
+    EXPECT_EQ(run(fetch, 0, &steps), fake_fetcher::status::done);
+    EXPECT_EQ(allocations.count(), 0);
+
+    EXPECT_EQ(fetch.count(), 3);
+    EXPECT_EQ(arrived[0], 1674785619);
+    EXPECT_EQ(arrived[2], 1674785753);
+    EXPECT_EQ(fetch.sample_ts().value(), 1674785282);
+    EXPECT_EQ(fetch.feed_ts().error(), error_code::bad_header);
+    EXPECT_EQ(fetch.step(0), fake_fetcher::status::idle);
+
+    // One bounded piece of I/O per step
+    EXPECT_GT(steps, int(socket.served / socket.piece));
+    EXPECT_EQ(socket.host, "example.com");
+    EXPECT_EQ(socket.port, 8080);
+    EXPECT_EQ(socket.request.rfind("GET /next_stop HTTP/1.0\r\nHost: example.com:8080\r\n", 0), 0);
+    EXPECT_NE(socket.request.find(std::string("Accept: ") + accept + "\r\n"), std::string::npos);
+    EXPECT_EQ(socket.request.find("If-None-Match"), std::string::npos);
+    EXPECT_FALSE(socket.open);
+}
+
+TEST(FetchBinaryTest, ShouldPass) {
+    auto encoded = encode_arrivals(1674785282, {
+        {1674785619, 1674785620, 2, '1'},
+        {1674785674, 1674785675, 1, '1'},
+    });
+    fake_socket socket;
+    socket.response = std::string("HTTP/1.0 200 OK\r\nContent-Type: ") + wire::content_type + "\r\n\r\n" +
+        std::string(encoded.begin(), encoded.end());
+    fake_fetcher fetch(socket, 5000);
+    ASSERT_TRUE(fetch.set_url("http://example.com/"));
+
+    timestamp_t arrived[3] = {};
+    fetch.start(arrived, 3, 0);
+    EXPECT_EQ(run(fetch), fake_fetcher::status::done);
+    EXPECT_EQ(fetch.count(), 2);
+    EXPECT_EQ(arrived[1], 1674785674);
+    // The binary body carries its own sample time
+    EXPECT_EQ(fetch.sample_ts().value(), 1674785282);
+}
+
+std::string binary_response(const std::vector<uint8_t>& body, bool content_length = true) {
+    return std::string("HTTP/1.1 200 OK\r\nContent-Type: ") + wire::content_type + "\r\n" +
+        (content_length ? "Content-Length: " + std::to_string(body.size()) + "\r\n" : "") + "\r\n" +
+        std::string(body.begin(), body.end());
+}
+
+TEST(FetchBinaryTruncatedTest, ShouldPass) {
+    std::vector<wire::arrival_record> records;
+    for (int64_t i = 0; i < 10; i++) records.push_back({1674785619 + i * 60, 1674785620 + i * 60, 1, '1'});
+    auto encoded = encode_arrivals(1674785282, records);
+    fake_socket socket;
+    fake_fetcher fetch(socket, 5000);
+    ASSERT_TRUE(fetch.set_url("http://example.com/"));
+    timestamp_t arrived[3] = {};
+
+    // Longer than the records kept: only the first ones are read
+    socket.response = binary_response(encoded);
+    fetch.start(arrived, 3, 0);
+    EXPECT_EQ(run(fetch), fake_fetcher::status::done);
+    EXPECT_EQ(fetch.count(), 3);
+    EXPECT_EQ(arrived[2], 1674785739);
+
+    // The connection closes before Content-Length bytes arrived
+    auto short_body = encode_arrivals(1674785282, {records[0], records[1]});
+    socket.response = binary_response(short_body);
+    socket.response.resize(socket.response.size() - 4);
+    fetch.start(arrived, 3, 0);
+    EXPECT_EQ(run(fetch), fake_fetcher::status::failed);
+    EXPECT_EQ(fetch.error(), error_code::truncated_body);
+
+    // Without a Content-Length, fewer records than the header announces
+    socket.response = binary_response(short_body, false);
+    socket.response.resize(socket.response.size() - 4);
+    fetch.start(arrived, 3, 0);
+    EXPECT_EQ(run(fetch), fake_fetcher::status::failed);
+    EXPECT_EQ(fetch.error(), error_code::truncated_body);
+}
+
+TEST(FetchEtagTest, ShouldPass) {
+    fake_socket socket;
+    socket.response = json_response(arrivals, "ETag: \"v1\"\r\nx-feed-timestamp: 1674785270\r\n");
+    fake_fetcher fetch(socket, 5000);
+    ASSERT_TRUE(fetch.set_url("http://example.com/"));
+
+    timestamp_t arrived[3];
+    fetch.start(arrived, 3, 0);
+    EXPECT_EQ(run(fetch), fake_fetcher::status::done);
+    EXPECT_EQ(fetch.feed_ts().value(), 1674785270);
+
+    socket.request.clear();
+    socket.response = "HTTP/1.1 304 Not Modified\r\nETag: \"v1\"\r\nx-timestamp: 1674785342\r\n\r\n";
+    fetch.start(arrived, 3, 0);
+    EXPECT_EQ(run(fetch), fake_fetcher::status::not_modified);
+    // Still resyncs the clock
+    EXPECT_EQ(fetch.sample_ts().value(), 1674785342);
+    EXPECT_NE(socket.request.find("If-None-Match: \"v1\"\r\n"), std::string::npos);
+
+    // A new URL forgets the validator
+    fetch.set_url("http://example.com/other");
+    socket.request.clear();
+    fetch.start(arrived, 3, 0);
+    run(fetch);
+    EXPECT_EQ(socket.request.find("If-None-Match"), std::string::npos);
+}
+
+TEST(FetchErrorsTest, ShouldPass) {
+    fake_socket socket;
+    fake_fetcher fetch(socket, 5000);
+    timestamp_t arrived[3];
+
+    EXPECT_FALSE(fetch.set_url("ftp://example.com/"));
+    fetch.start(arrived, 3, 0);
+    EXPECT_EQ(fetch.step(0), fake_fetcher::status::failed);
+    EXPECT_EQ(fetch.error(), error_code::bad_url);
+
+    ASSERT_TRUE(fetch.set_url("http://example.com/"));
+    socket.accept = false;
+    fetch.start(arrived, 3, 0);
+    EXPECT_EQ(run(fetch), fake_fetcher::status::failed);
+    EXPECT_EQ(fetch.error(), error_code::connection_failed);
+    socket.accept = true;
+
+    socket.response = "HTTP/1.1 500 Internal Server Error\r\n\r\n";
+    fetch.start(arrived, 3, 0);
+    EXPECT_EQ(run(fetch), fake_fetcher::status::failed);
+    EXPECT_EQ(fetch.error(), error_code::bad_status);
+    EXPECT_EQ(fetch.http_status(), 500);
+
+    socket.response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n\r\n" + arrivals;
+    fetch.start(arrived, 3, 0);
+    EXPECT_EQ(run(fetch), fake_fetcher::status::failed);
+    EXPECT_EQ(fetch.error(), error_code::bad_header);
+
+    // The connection closes half way through the body
+    socket.response = json_response(arrivals);
+    socket.response.resize(socket.response.size() - arrivals.size() + 20);
+    fetch.start(arrived, 3, 0);
+    EXPECT_EQ(run(fetch), fake_fetcher::status::failed);
+    EXPECT_EQ(fetch.error(), error_code::truncated_body);
+
+    socket.response = "HTTP/1.1 200";
+    fetch.start(arrived, 3, 0);
+    EXPECT_EQ(run(fetch), fake_fetcher::status::failed);
+    EXPECT_EQ(fetch.error(), error_code::truncated_body);
+}
+
+TEST(FetchTimeoutTest, ShouldPass) {
+    fake_socket socket;
+    socket.response = json_response(arrivals);
+    socket.piece = 0;  // connected, but the server never answers
+    fake_fetcher fetch(socket, 5000);
+    ASSERT_TRUE(fetch.set_url("http://example.com/"));
+
+    timestamp_t arrived[3];
+    fetch.start(arrived, 3, 1000);
+    EXPECT_EQ(fetch.step(2000), fake_fetcher::status::busy);
+    EXPECT_EQ(fetch.step(5999), fake_fetcher::status::busy);
+    EXPECT_EQ(fetch.step(6000), fake_fetcher::status::failed);
+    EXPECT_EQ(fetch.error(), error_code::timed_out);
+    EXPECT_FALSE(socket.open);
+}
+
+TEST(FetchPartialWritesTest, ShouldPass) {
+    fake_socket socket;
+    socket.response = json_response(arrivals);
+    socket.write_limit = 10;
+    fake_fetcher fetch(socket, 5000);
+    ASSERT_TRUE(fetch.set_url("http://example.com/"));
+
+    timestamp_t arrived[3];
+    fetch.start(arrived, 3, 0);
+    EXPECT_EQ(run(fetch), fake_fetcher::status::done);
+    EXPECT_EQ(socket.request.substr(socket.request.size() - 4), "\r\n\r\n");
+}
+
+TEST(FetchLoopbackTest, ShouldPass) {
+    std::string received;
+    loopback::server server([&](const std::string& request) {
+        received = request;
+        return json_response(arrivals);
+    });
+
+    loopback::socket socket;
+    fetcher<loopback::socket> fetch(socket, 5000);
+    ASSERT_TRUE(fetch.set_url(server.url("/next_stop")));
+
+    timestamp_t arrived[3] = {};
+    fetch.start(arrived, 3, 0);
+    EXPECT_EQ(run(fetch), fetcher<loopback::socket>::status::done);
+    EXPECT_EQ(fetch.count(), 3);
+    EXPECT_EQ(arrived[1], 1674785674);
+    EXPECT_EQ(received.rfind("GET /next_stop HTTP/1.0\r\n", 0), 0);
+}
+
+TEST(FetchKeepAliveTest, ShouldPass) {
+    fake_socket socket;
+    socket.keep_alive = true;
+    socket.response = json_response(arrivals, "Connection: keep-alive\r\n");
+    fake_fetcher fetch(socket, 5000, 30000);
+    ASSERT_TRUE(fetch.set_url("http://example.com/"));
+
+    timestamp_t arrived[3];
+    fetch.start(arrived, 3, 0);
+    EXPECT_EQ(run(fetch, 0), fake_fetcher::status::done);
+    EXPECT_NE(socket.request.find("Connection: keep-alive\r\n"), std::string::npos);
+    EXPECT_TRUE(socket.open);
+
+    fetch.start(arrived, 3, 10000);
+    EXPECT_EQ(run(fetch, 10000), fake_fetcher::status::done);
+    EXPECT_EQ(fetch.count(), 3);
+    EXPECT_EQ(fetch.handshakes(), 1);
+    EXPECT_EQ(fetch.requests(), 2);
+
+    // Idle for too long
+    fetch.start(arrived, 3, 40000);
+    EXPECT_EQ(run(fetch, 40000), fake_fetcher::status::done);
+    EXPECT_EQ(fetch.handshakes(), 2);
+
+    // Nothing to fetch: the connection is kept for the next one
+    fetch.start(arrived, 0, 45000);
+    EXPECT_EQ(fetch.step(45000), fake_fetcher::status::done);
+    EXPECT_EQ(fetch.count(), 0);
+    EXPECT_TRUE(socket.open);
+    EXPECT_EQ(fetch.requests(), 3);
+    fetch.start(arrived, 3, 46000);
+    EXPECT_EQ(run(fetch, 46000), fake_fetcher::status::done);
+    EXPECT_EQ(fetch.handshakes(), 2);
+
+    // Closed by the server in the meantime: retried on a new connection within the same fetch
+    socket.hang_up = true;
+    fetch.start(arrived, 3, 50000);
+    EXPECT_EQ(run(fetch, 50000), fake_fetcher::status::done);
+    EXPECT_EQ(fetch.count(), 3);
+    EXPECT_EQ(fetch.handshakes(), 3);
+    EXPECT_EQ(socket.connects, 3);
+
+    // A new URL doesn't reuse the connection to the old host
+    fetch.set_url("http://example.com/other");
+    EXPECT_FALSE(socket.open);
+}
+
+TEST(FetchKeepAliveDeclinedTest, ShouldPass) {
+    fake_socket socket;
+    fake_fetcher fetch(socket, 5000, 30000);
+    ASSERT_TRUE(fetch.set_url("http://example.com/"));
+    timestamp_t arrived[3];
+
+    // The server didn't agree to keep it
+    socket.response = json_response(arrivals);
+    fetch.start(arrived, 3, 0);
+    EXPECT_EQ(run(fetch), fake_fetcher::status::done);
+    EXPECT_FALSE(socket.open);
+
+    // Nor can it, with the end of the body only shown by closing
+    socket.response = "HTTP/1.0 200 OK\r\nConnection: keep-alive\r\nx-timestamp: 1674785282\r\n\r\n" + arrivals;
+    fetch.start(arrived, 3, 0);
+    EXPECT_EQ(run(fetch), fake_fetcher::status::done);
+    EXPECT_FALSE(socket.open);
+
+    // A failure always closes
+    socket.keep_alive = true;
+    socket.response = "HTTP/1.1 500 Internal Server Error\r\nConnection: keep-alive\r\nContent-Length: 0\r\n\r\n";
+    fetch.start(arrived, 3, 0);
+    EXPECT_EQ(run(fetch), fake_fetcher::status::failed);
+    EXPECT_FALSE(socket.open);
+    EXPECT_EQ(fetch.handshakes(), 3);
+}
+
+TEST(FetchLoopbackKeepAliveTest, ShouldPass) {
+    loopback::server server([](const std::string&) {
+        return json_response(arrivals, "Connection: keep-alive\r\n");
+    }, 2, true);
+
+    loopback::socket socket;
+    fetcher<loopback::socket> fetch(socket, 5000, 30000);
+    ASSERT_TRUE(fetch.set_url(server.url("/next_stop")));
+
+    // Fewer arrivals than sent: the rest of the body is drained so the next response parses
+    timestamp_t arrived[2] = {};
+    for (unsigned long now = 0; now < 5000; now += 1000) {
+        fetch.start(arrived, 2, now);
+        ASSERT_EQ(run(fetch, now), fetcher<loopback::socket>::status::done);
+        EXPECT_EQ(fetch.count(), 2);
+        EXPECT_EQ(arrived[1], 1674785674);
+    }
+    EXPECT_EQ(fetch.handshakes(), 1);
+    EXPECT_EQ(socket.connects, 1);
+
+    // Past the idle limit the connection is replaced
+    fetch.start(arrived, 2, 60000);
+    EXPECT_EQ(run(fetch, 60000), fetcher<loopback::socket>::status::done);
+    EXPECT_EQ(fetch.handshakes(), 2);
+    EXPECT_EQ(fetch.requests(), 6);
+    fetch.abort();
+}
@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+#include <PollPolicy.hpp>
+
+#include <limits>
+
+using namespace next_stop;
+
+const timestamp_t sample = 1674785282;
+
+TEST(FixedPollTest, ShouldPass) {
+    fixed_poll policy{8000, 1000};
+    EXPECT_EQ(policy.on_response({sample, {}, sample + 60}), 8000);
+    EXPECT_EQ(policy.on_failure(), 1000);
+}
+
+TEST(AdaptivePollArrivalTest, ShouldPass) {
+    adaptive_poll policy;
+
+    // No train due, e.g. at night
+    EXPECT_EQ(policy.on_response({sample, {}, {}}), 600000);
+    // Twice before the train arrives
+    EXPECT_EQ(policy.on_response({sample, {}, sample + 120}), 60000);
+    EXPECT_EQ(policy.on_response({sample, {}, sample + 3600}), 600000);
+    // Never faster than the minimum, trains due or departed included
+    EXPECT_EQ(policy.on_response({sample, {}, sample + 10}), 15000);
+    EXPECT_EQ(policy.on_response({sample, {}, sample - 10}), 15000);
+    EXPECT_EQ(policy.on_response({sample, {}, std::numeric_limits<timestamp_t>::min()}), 15000);
+    EXPECT_EQ(policy.on_response({sample, {}, std::numeric_limits<timestamp_t>::max()}), 600000);
+}
+
+TEST(AdaptivePollFeedTest, ShouldPass) {
+    adaptive_poll policy;
+
+    // The feed is 10s old, the next one is expected 25s from now
+    EXPECT_EQ(policy.on_response({sample, sample - 10, sample + 10}), 25000);
+    // The last refresh before the wanted delay
+    EXPECT_EQ(policy.on_response({sample, sample - 10, sample + 120}), 55000);
+    EXPECT_EQ(policy.on_response({sample, sample - 10, {}}), 595000);
+
+    // The next refresh is due sooner than the minimum, wait for the one after it
+    EXPECT_EQ(policy.on_response({sample, sample - 33, sample + 10}), 32000);
+    for (timestamp_t age = 30; age < 35; age++) {
+        EXPECT_GE(policy.on_response({sample, sample - age, sample + 10}), 15000);
+    }
+
+    // Overdue: the refresh could land any moment
+    EXPECT_EQ(policy.on_response({sample, sample - 40, sample + 120}), 60000);
+    // Stopped updating, or from the future
+    EXPECT_EQ(policy.on_response({sample, sample - 3600, sample + 10}), 15000);
+    EXPECT_EQ(policy.on_response({sample, sample + 10, sample + 10}), 15000);
+    EXPECT_EQ(policy.on_response({sample, std::numeric_limits<timestamp_t>::min(), sample + 10}), 15000);
+}
+
+TEST(AdaptivePollBackoffTest, ShouldPass) {
+    adaptive_poll policy({}, 42);
+
+    unsigned long backoff = 2000;
+    for (int i = 0; i < 12; i++) {
+        unsigned long delay = policy.on_failure();
+        EXPECT_GE(delay, backoff / 2);
+        EXPECT_LE(delay, backoff);
+        backoff = std::min(backoff * 2, 300000ul);
+    }
+    EXPECT_EQ(policy.failures(), 12);
+
+    // Jitter spreads out devices that failed together
+    adaptive_poll a({}, 1), b({}, 2);
+    for (int i = 0; i < 5; i++) a.on_failure(), b.on_failure();
+    EXPECT_NE(a.on_failure(), b.on_failure());
+
+    // A response starts over
+    policy.on_response({sample, {}, {}});
+    EXPECT_EQ(policy.failures(), 0);
+    EXPECT_LE(policy.on_failure(), 2000);
+}
+
+// A day against a simulated server: its feed refreshes every 30s, trains run every 5 minutes from
+// 6:00 and are known an hour ahead. Counts the polls, and how stale the shown data is while a
+// train is close.
+struct simulation {
+    int polls = 0;
+    timestamp_t worst_staleness = 0;
+
+    static timestamp_t feed_at(timestamp_t t) { return (t - 7) / 30 * 30 + 7; }
+    static std::optional<timestamp_t> soonest_at(timestamp_t t) {
+        if (t < 5 * 3600) return {};
+        return std::max<timestamp_t>(6 * 3600, (t + 299) / 300 * 300);
+    }
+
+    template <class Policy>
+    simulation(Policy& policy) {
+        timestamp_t held = 0;
+        timestamp_t next = 0;
+        for (timestamp_t t = 37; t < 24 * 3600; t++) {
+            if (t >= next) {
+                polls++;
+                held = feed_at(t);
+                next = t + (policy.on_response({t, feed_at(t), soonest_at(t)}) + 999) / 1000;
+            }
+            auto soonest = soonest_at(t);
+            if (soonest && *soonest - t <= 120) worst_staleness = std::max(worst_staleness, feed_at(t) - held);
+        }
+    }
+};
+
+TEST(AdaptivePollSimulationTest, ShouldPass) {
+    fixed_poll fixed{8000, 1000};
+    adaptive_poll adaptive;
+    simulation every_8s(fixed), adapted(adaptive);
+
+    EXPECT_LT(adapted.polls * 4, every_8s.polls);
+    // At most two refreshes behind when it matters
+    EXPECT_LE(adapted.worst_staleness, 60);
+}
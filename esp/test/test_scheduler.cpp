@@ -0,0 +1,187 @@
+#include <gtest/gtest.h>
+#include <Scheduler.hpp>
+
+#include <string>
+#include <vector>
+
+#include "alloc_counter.hpp"
+
+struct fake_clock {
+    unsigned long ms = 0;
+    unsigned long now() const { return ms; }
+};
+
+using test_scheduler = scheduler::Scheduler<fake_clock, 4>;
+
+// Logs its name on every run and takes `cost` milliseconds of the fake clock
+struct logging_task {
+    const char* name;
+    std::vector<std::string>* log;
+    fake_clock* clock;
+    unsigned long cost = 0;
+    unsigned long last_deadline = 0;
+
+    static void run(void* context, unsigned long, unsigned long deadline) {
+        auto* self = static_cast<logging_task*>(context);
+        self->log->push_back(self->name);
+        self->clock->ms += self->cost;
+        self->last_deadline = deadline;
+    }
+};
+
+TEST(SchedulerPeriodsTest, ShouldPass) {
+    fake_clock clock;
+    test_scheduler tasks(clock);
+    std::vector<std::string> log;
+    logging_task render{"render", &log, &clock};
+    logging_task fetch{"fetch", &log, &clock};
+
+    EXPECT_EQ(tasks.add("render", logging_task::run, &render, 100, 10), 0);
+    EXPECT_EQ(tasks.add("fetch", logging_task::run, &fetch, 250, 10, 50), 1);
+
+    EXPECT_EQ(tasks.tick(), 50);
+    for (clock.ms = 1; clock.ms <= 500; clock.ms++) tasks.tick();
+
+    EXPECT_EQ(log, std::vector<std::string>({
+        "render", "fetch", "render", "render", "render", "fetch", "render", "render"
+    }));
+    EXPECT_EQ(tasks.stats(0).runs, 6);
+    EXPECT_EQ(tasks.stats(1).runs, 2);
+}
+
+TEST(SchedulerEarliestDeadlineFirstTest, ShouldPass) {
+    fake_clock clock;
+    test_scheduler tasks(clock);
+    std::vector<std::string> log;
+    logging_task a{"a", &log, &clock};
+    logging_task b{"b", &log, &clock};
+    logging_task c{"c", &log, &clock};
+
+    tasks.add("a", logging_task::run, &a, 1000, 10, 30);
+    tasks.add("b", logging_task::run, &b, 1000, 10, 10);
+    tasks.add("c", logging_task::run, &c, 1000, 10, 20);
+
+    // All three are overdue, the one that has waited longest goes first
+    clock.ms = 100;
+    EXPECT_EQ(tasks.tick(), 910);
+    EXPECT_EQ(log, std::vector<std::string>({"b", "c", "a"}));
+}
+
+TEST(SchedulerBudgetTest, ShouldPass) {
+    fake_clock clock;
+    test_scheduler tasks(clock);
+    std::vector<std::string> log;
+    logging_task slow{"slow", &log, &clock, 25};
+
+    tasks.add("slow", logging_task::run, &slow, 100, 20);
+    tasks.tick();
+    EXPECT_EQ(slow.last_deadline, 20);
+    EXPECT_EQ(tasks.stats(0).overruns, 1);
+    EXPECT_EQ(tasks.stats(0).longest_ms, 25);
+
+    slow.cost = 5;
+    clock.ms = 100;
+    tasks.tick();
+    EXPECT_EQ(tasks.stats(0).runs, 2);
+    EXPECT_EQ(tasks.stats(0).overruns, 1);
+}
+
+TEST(SchedulerCatchUpTest, ShouldPass) {
+    fake_clock clock;
+    test_scheduler tasks(clock);
+    std::vector<std::string> log;
+    logging_task frame{"frame", &log, &clock};
+    logging_task zero{"zero", &log, &clock};
+
+    tasks.add("frame", logging_task::run, &frame, 100, 10);
+    tasks.tick();
+
+    // Stalled for 10 periods: one run, not ten
+    clock.ms = 1050;
+    EXPECT_EQ(tasks.tick(), 100);
+    EXPECT_EQ(tasks.stats(0).runs, 2);
+
+    // A zero period task runs once per tick
+    tasks.add("zero", logging_task::run, &zero, 0, 1);
+    tasks.tick();
+    tasks.tick();
+    EXPECT_EQ(tasks.stats(1).runs, 2);
+    EXPECT_EQ(tasks.idle_ms(), 0);
+}
+
+TEST(SchedulerRunInTest, ShouldPass) {
+    fake_clock clock;
+    test_scheduler tasks(clock);
+    std::vector<std::string> log;
+    logging_task poll{"poll", &log, &clock};
+
+    int id = tasks.add("poll", logging_task::run, &poll, 10000, 10);
+    tasks.tick();
+    tasks.run_in(id, 500);
+    EXPECT_EQ(tasks.idle_ms(), 500);
+
+    clock.ms = 500;
+    tasks.tick();
+    EXPECT_EQ(tasks.stats(id).runs, 2);
+    EXPECT_EQ(tasks.idle_ms(), 10000);
+}
+
+// Reschedules itself from inside its run
+struct self_rescheduling_task {
+    test_scheduler* tasks;
+    int id;
+    unsigned long delay_ms;
+
+    static void run(void* context, unsigned long, unsigned long) {
+        auto* self = static_cast<self_rescheduling_task*>(context);
+        self->tasks->run_in(self->id, self->delay_ms);
+    }
+};
+
+TEST(SchedulerRunInFromTaskTest, ShouldPass) {
+    fake_clock clock;
+    test_scheduler tasks(clock);
+    self_rescheduling_task t{&tasks, 0, 300};
+
+    t.id = tasks.add("self", self_rescheduling_task::run, &t, 10000, 10);
+    tasks.tick();
+    // Not pushed back by the period on top
+    EXPECT_EQ(tasks.idle_ms(), 300);
+
+    clock.ms = 300;
+    tasks.tick();
+    EXPECT_EQ(tasks.stats(t.id).runs, 2);
+    EXPECT_EQ(tasks.idle_ms(), 300);
+}
+
+TEST(SchedulerWrapAroundTest, ShouldPass) {
+    fake_clock clock;
+    clock.ms = std::numeric_limits<unsigned long>::max() - 50;
+    test_scheduler tasks(clock);
+    std::vector<std::string> log;
+    logging_task t{"t", &log, &clock};
+
+    tasks.add("t", logging_task::run, &t, 100, 10);
+    tasks.tick();
+    clock.ms += 99;
+    tasks.tick();
+    EXPECT_EQ(tasks.stats(0).runs, 1);
+    clock.ms += 1;
+    tasks.tick();
+    EXPECT_EQ(tasks.stats(0).runs, 2);
+}
+
+TEST(SchedulerCapacityNoAllocTest, ShouldPass) {
+    fake_clock clock;
+    test_scheduler tasks(clock);
+    int runs = 0;
+    auto count = [](void* context, unsigned long, unsigned long) { ++*static_cast<int*>(context); };
+
+    alloc_counter::scope allocations;
+    for (std::size_t i = 0; i < test_scheduler::capacity(); i++) EXPECT_GE(tasks.add("t", count, &runs, 10, 1), 0);
+    EXPECT_EQ(tasks.add("t", count, &runs, 10, 1), -1);
+    for (clock.ms = 0; clock.ms < 100; clock.ms++) tasks.tick();
+    EXPECT_EQ(allocations.count(), 0);
+
+    EXPECT_EQ(runs, 4 * 10);
+}
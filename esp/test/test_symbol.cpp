@@ -1,6 +1,10 @@
 #include <gtest/gtest.h>
 #include <symbol.hpp>
 
+#include <climits>
+
+#include "alloc_counter.hpp"
+
 // TEST(...)
 // TEST_F(...)
 
@@ -138,3 +142,343 @@ TEST(SymArrayMutationTest, ShouldPass) {
     symbols.append(symbol::ZERO);
     EXPECT_EQ(iterSym(symbols), symbol::ZERO.cols() + symbol::ZERO.cols());
 }
+
+TEST(PackedGlyphTest, ShouldPass) {
+    static_assert(sizeof(symbol::packedONE_TRAIN) == 8);
+    static_assert(symbol::packedZERO.bits[0] == 0b01111100);
+    static_assert(symbol::packedONE.bits[2] == 0b11111110);
+    static_assert(symbol::ONE_TRAIN.cols() == 8);
+
+    // Same pixels as the column-major table the glyph was defined with
+    const char expected[] = {
+      0, 1, 0, 1, 0, 1, 0, 1,
+      0, 1, 0, 0, 1, 0, 0, 1,
+    };
+    auto it = symbol::EIGHT.rows_iter();
+    ++it;
+    for (int col = 0; col < 2; col++, ++it) {
+        for (int row = 0; row < 8; row++) {
+            EXPECT_EQ((*it)[row], expected[col * 8 + row]) << col << "," << row;
+        }
+    }
+}
+
+TEST(SymArrayIteratorColumnsTest, ShouldPass) {
+    const auto symbols = symbol::SymbolArray( {
+        symbol::ONE,
+        symbol::SPACE,
+        symbol::TWO
+    });
+
+    std::vector<uint8_t> expected;
+    for (const auto* s : {&symbol::ONE, &symbol::SPACE, &symbol::TWO}) {
+        for (auto column : s->rows_iter()) expected.push_back(column.bits);
+    }
+
+    std::vector<uint8_t> columns;
+    for (auto column : symbols.rows_iter()) columns.push_back(column.bits);
+    EXPECT_EQ(columns, expected);
+
+    int empty = 0;
+    for ([[maybe_unused]] auto column : symbol::SymbolArray().rows_iter()) empty++;
+    EXPECT_EQ(empty, 0);
+}
+
+TEST(SymArrayIteratorNoAllocTest, ShouldPass) {
+    const auto symbols = symbol::SymbolArray( {
+        symbol::ONE,
+        symbol::SPACE,
+        symbol::TWO,
+        symbol::SPACE
+    });
+
+    // What drawSymbol does every frame
+    alloc_counter::scope allocations;
+    int lit = 0;
+    for (int frame = 0; frame < 10; frame++) {
+        for (auto column : symbols.rows_iter()) {
+            for (int i = 0; i < 8; i++) lit += column[i];
+        }
+    }
+
+    EXPECT_EQ(allocations.count(), 0);
+    EXPECT_GT(lit, 0);
+}
+
+TEST(SymArrayCapacityTest, ShouldPass) {
+    symbol::SymbolArray<2> symbols;
+    EXPECT_TRUE(symbols.append(symbol::ONE));
+    EXPECT_TRUE(symbols.append(symbol::TWO));
+    EXPECT_FALSE(symbols.append(symbol::THREE));
+
+    EXPECT_EQ(symbols.size(), 2);
+    EXPECT_EQ(symbols.cols(), symbol::ONE.cols() + symbol::TWO.cols());
+    EXPECT_EQ(iterSym(symbols), symbols.cols());
+
+    symbols.clear();
+    EXPECT_EQ(symbols.cols(), 0);
+    EXPECT_EQ(iterSym(symbols), 0);
+}
+
+TEST(SymArrayBuildNoAllocTest, ShouldPass) {
+    symbol::SymbolArray<> symbols;
+
+    alloc_counter::scope allocations;
+    for (int n = 0; n < 10; n++) {
+        symbols.append(*symbol::SYM_NUMERIC[n]);
+        symbols.append(symbol::SPACE);
+    }
+
+    EXPECT_EQ(allocations.count(), 0);
+    EXPECT_EQ(symbols.size(), 2 * 10);
+}
+
+TEST(ColumnBitmapRenderTest, ShouldPass) {
+    const auto symbols = symbol::SymbolArray( {
+        symbol::ONE,
+        symbol::SPACE,
+        symbol::TWO
+    });
+
+    symbol::ColumnBitmap<32> bitmap;
+    bitmap.render(symbols);
+    EXPECT_EQ(bitmap.cols(), symbols.cols());
+
+    std::vector<uint8_t> expected;
+    for (auto column : symbols.rows_iter()) expected.push_back(column.bits);
+
+    std::vector<uint8_t> columns;
+    for (auto column : bitmap.rows_iter()) columns.push_back(column.bits);
+    EXPECT_EQ(columns, expected);
+
+    // Slices are clipped to the rendered columns
+    columns.clear();
+    for (auto column : bitmap.slice(3, 100)) columns.push_back(column.bits);
+    EXPECT_EQ(columns, std::vector<uint8_t>(expected.begin() + 3, expected.end()));
+    EXPECT_EQ(iterSym(bitmap), symbols.cols());
+
+    int empty = 0;
+    for ([[maybe_unused]] auto column : bitmap.slice(50, 60)) empty++;
+    EXPECT_EQ(empty, 0);
+
+    // Rendering stops at the capacity
+    symbol::ColumnBitmap<4> small;
+    small.render(symbols);
+    EXPECT_EQ(small.cols(), 4);
+}
+
+TEST(ColumnBitmapNoAllocTest, ShouldPass) {
+    const auto symbols = symbol::SymbolArray( {
+        symbol::FOUR,
+        symbol::SPACE,
+        symbol::TWO
+    });
+    symbol::ColumnBitmap<64> bitmap;
+
+    alloc_counter::scope allocations;
+    bitmap.render(symbols);
+    int lit = 0;
+    for (auto column : bitmap.slice(2, 10)) {
+        for (int i = 0; i < 8; i++) lit += column[i];
+    }
+
+    EXPECT_EQ(allocations.count(), 0);
+    EXPECT_GT(lit, 0);
+}
+
+template <class Sym, class Iter>
+std::vector<uint8_t> sliceBits(const symbol::ISymbol<Sym, Iter>& symbol, std::size_t begin, std::size_t end) {
+    std::vector<uint8_t> columns;
+    for (auto column : symbol.slice(begin, end)) columns.push_back(column.bits);
+    return columns;
+}
+
+TEST(SymbolSliceTest, ShouldPass) {
+    const auto symbols = symbol::SymbolArray( {
+        symbol::ONE,
+        symbol::SPACE,
+        symbol::TWO,
+        symbol::EIGHT
+    });
+    symbol::ColumnBitmap<32> bitmap;
+    bitmap.render(symbols);
+
+    std::vector<uint8_t> all;
+    for (auto column : symbols.rows_iter()) all.push_back(column.bits);
+
+    for (std::size_t i = 0; i < all.size(); i++) {
+        EXPECT_EQ(symbols.column_at(i).bits, all[i]) << i;
+        EXPECT_EQ(bitmap.column_at(i).bits, all[i]) << i;
+    }
+    EXPECT_EQ(symbol::TWO.column_at(1).bits, all[symbol::ONE.cols() + 1 + 1]);
+    // Past the end, and on an empty array
+    EXPECT_EQ(symbols.column_at(all.size()).bits, 0);
+    EXPECT_EQ(symbols.column_at(all.size() + 100).bits, 0);
+    EXPECT_EQ(symbol::SymbolArray().column_at(0).bits, 0);
+
+    // Every window, including ones that start or end on a glyph boundary or past the end
+    for (std::size_t begin = 0; begin <= all.size() + 1; begin++) {
+        for (std::size_t end = begin; end <= all.size() + 2; end++) {
+            auto first = std::min(begin, all.size());
+            auto last = std::min(end, all.size());
+            std::vector<uint8_t> expected(all.begin() + first, all.begin() + last);
+            EXPECT_EQ(sliceBits(symbols, begin, end), expected) << begin << ".." << end;
+            EXPECT_EQ(sliceBits(bitmap, begin, end), expected) << begin << ".." << end;
+        }
+    }
+
+    std::vector<uint8_t> two(all.begin() + 5, all.begin() + 10);
+    EXPECT_EQ(sliceBits(symbol::TWO, 0, 99), two);
+    EXPECT_EQ(sliceBits(symbol::TWO, 2, 4), std::vector<uint8_t>(two.begin() + 2, two.begin() + 4));
+}
+
+// Every kind of symbol reads a blank column past its end
+TEST(SymbolColumnAtPastEndTest, ShouldPass) {
+    const auto symbols = symbol::SymbolArray({symbol::ONE, symbol::TWO});
+    symbol::ColumnBitmap<32> bitmap;
+    bitmap.render(symbols);
+
+    auto one = symbol::ONE.cols();
+    EXPECT_NE(symbol::ONE.column_at(one - 1).bits, 0);
+    EXPECT_EQ(symbol::ONE.column_at(one).bits, 0);
+    EXPECT_EQ(symbol::ONE.column_at(one + 100).bits, 0);
+
+    EXPECT_NE(symbols.column_at(symbols.cols() - 1).bits, 0);
+    EXPECT_EQ(symbols.column_at(symbols.cols()).bits, 0);
+    EXPECT_EQ(symbols.column_at(symbols.cols() + 100).bits, 0);
+
+    // Past the rendered columns, and past the capacity
+    EXPECT_NE(bitmap.column_at(bitmap.cols() - 1).bits, 0);
+    EXPECT_EQ(bitmap.column_at(bitmap.cols()).bits, 0);
+    EXPECT_EQ(bitmap.column_at(bitmap.capacity() + 100).bits, 0);
+    EXPECT_EQ(symbol::ColumnBitmap<4>().column_at(0).bits, 0);
+}
+
+TEST(LineTest, ShouldPass) {
+    const auto minutes = symbol::SymbolArray( {
+        symbol::ONE,
+        symbol::TWO
+    });
+    symbol::ColumnBitmap<32> rendered;
+    rendered.render(minutes);
+
+    symbol::Line<int, 4, symbol::constSym8, symbol::SymbolArray<>, symbol::ColumnBitmap<32>> line;
+    EXPECT_TRUE(line.add(symbol::ONE_TRAIN, 1));
+    EXPECT_TRUE(line.add(minutes, 2));
+    EXPECT_TRUE(line.add(rendered, 3, true));
+    EXPECT_EQ(line.cols(), symbol::ONE_TRAIN.cols() + 2 * minutes.cols());
+
+    // What the render loop does every frame
+    alloc_counter::scope allocations;
+    int colors[3] = {};
+    int scrolling = -1;
+    int segment = 0;
+    line.for_each([&](const auto& symbol, int color, bool scrolls) {
+        colors[segment] = color;
+        if (scrolls) scrolling = segment;
+        EXPECT_EQ(iterSym(symbol), symbol.cols());
+        segment++;
+    });
+    EXPECT_EQ(allocations.count(), 0);
+
+    EXPECT_EQ(segment, 3);
+    EXPECT_EQ(colors[0], 1);
+    EXPECT_EQ(colors[1], 2);
+    EXPECT_EQ(colors[2], 3);
+    EXPECT_EQ(scrolling, 2);
+
+    EXPECT_TRUE(line.add(symbol::SPACE, 4));
+    EXPECT_FALSE(line.add(symbol::SPACE, 5));
+    EXPECT_EQ(line.size(), 4);
+
+    line.clear();
+    EXPECT_EQ(line.cols(), 0);
+}
+
+constexpr auto NO_DATA = symbol::layout<symbol::layout_size("NO DATA")>("NO DATA");
+static_assert(NO_DATA.size() == 13);
+static_assert(NO_DATA.cols() == 5 + 1 + 5 + 1 + 1 + 1 + 5 + 1 + 5 + 1 + 5 + 1 + 5);
+
+TEST(FontLayoutTest, ShouldPass) {
+    // Blank columns around a glyph are trimmed
+    static_assert(symbol::glyph('I').cols() == 3);
+    static_assert(symbol::glyph('!').cols() == 1);
+    static_assert(symbol::glyph(' ').cols() == 1);
+    static_assert(symbol::glyph('W').cols() == 5);
+    EXPECT_EQ(&symbol::glyph('\n'), &symbol::glyph('?'));
+
+    // Rows sit on the digits' baseline, the top row stays blank
+    for (char c = symbol::font::FIRST; c <= symbol::font::LAST; c++) {
+        for (auto column : symbol::glyph(c).rows_iter()) EXPECT_EQ(column.bits & 1, 0) << c;
+    }
+    EXPECT_EQ(symbol::glyph('I').column_at(1).bits, 0xFE);
+
+    auto text = symbol::layout("Hi");
+    EXPECT_EQ(text.size(), 3);
+    EXPECT_EQ(text.cols(), symbol::glyph('H').cols() + 1 + symbol::glyph('i').cols());
+    EXPECT_EQ(text.column_at(0).bits, symbol::glyph('H').column_at(0).bits);
+    EXPECT_EQ(text.column_at(5).bits, 0);
+
+    EXPECT_EQ(iterSym(NO_DATA), NO_DATA.cols());
+    EXPECT_EQ(symbol::layout<3>("ABC").size(), 3);
+    EXPECT_EQ(symbol::layout("").cols(), 0);
+}
+
+template <class Sym, class Iter>
+std::vector<uint8_t> allBits(const symbol::ISymbol<Sym, Iter>& symbol) {
+    return sliceBits(symbol, 0, symbol.cols());
+}
+
+TEST(FormatNumberTest, ShouldPass) {
+    symbol::ColumnBitmap<64> bitmap;
+
+    // Zero renders, unlike with the old addNumberToArray
+    EXPECT_TRUE(symbol::format_number(bitmap, 0));
+    EXPECT_EQ(allBits(bitmap), allBits(symbol::ZERO));
+
+    bitmap.clear();
+    EXPECT_TRUE(symbol::format_number(bitmap, 12));
+    EXPECT_EQ(allBits(bitmap), allBits(symbol::SymbolArray({symbol::ONE, symbol::SPACE, symbol::TWO})));
+
+    bitmap.clear();
+    EXPECT_TRUE(symbol::format_number(bitmap, -7, {0, &symbol::glyph('m')}));
+    EXPECT_EQ(allBits(bitmap), allBits(symbol::SymbolArray({
+        symbol::glyph('-'), symbol::SPACE, symbol::SEVEN, symbol::SPACE, symbol::glyph('m')
+    })));
+
+    // Right-aligned in a fixed width, so the last column stays put
+    const symbol::number_format fixed = {13};
+    for (int n : {1, 9, 10, 88}) {
+        bitmap.clear();
+        EXPECT_TRUE(symbol::format_number(bitmap, n, fixed));
+        EXPECT_EQ(bitmap.cols(), 13) << n;
+        EXPECT_EQ(bitmap.column_at(12).bits, symbol::SYM_NUMERIC[n % 10]->column_at(symbol::SYM_NUMERIC[n % 10]->cols() - 1).bits) << n;
+    }
+
+    // Wider numbers grow past the width
+    bitmap.clear();
+    EXPECT_TRUE(symbol::format_number(bitmap, 888, fixed));
+    EXPECT_EQ(bitmap.cols(), 3 * symbol::EIGHT.cols() + 2);
+
+    bitmap.clear();
+    EXPECT_TRUE(symbol::format_number(bitmap, INT_MIN));
+    EXPECT_EQ(bitmap.column_at(0).bits, symbol::glyph('-').column_at(0).bits);
+
+    symbol::ColumnBitmap<6> small;
+    EXPECT_FALSE(symbol::format_number(small, 88));
+    EXPECT_EQ(small.cols(), 6);
+}
+
+TEST(FormatNumberNoAllocTest, ShouldPass) {
+    symbol::ColumnBitmap<128> minutes;
+
+    // What LoopState::reset does for every new set of arrivals
+    alloc_counter::scope allocations;
+    for (int n : {0, 12, 104}) {
+        EXPECT_TRUE(symbol::format_number(minutes, n, {13}));
+        EXPECT_TRUE(minutes.append_blank(3));
+    }
+
+    EXPECT_EQ(allocations.count(), 0);
+    EXPECT_EQ(minutes.cols(), 13 + 3 + 13 + 3 + (symbol::ONE.cols() + symbol::ZERO.cols() + symbol::FOUR.cols() + 2) + 3);
+}
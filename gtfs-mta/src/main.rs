@@ -18,6 +18,8 @@ use axum::{
     extract::Path,
     extract::State, 
     extract::Query,
+    http::{header, HeaderMap},
+    response::IntoResponse,
     response::Response,
     response::Json,
     routing::get,
@@ -236,8 +238,18 @@ async fn next_train_handler(
     from: &str, direction: &str, 
     future_only: Option<bool>, 
     limit_direction_departures: Option<i8>
-) -> Json<Vec<Entry>> {
-    let mut s = state.cache_from.read().await;
+) -> Vec<Entry> {
+    let s = state.cache_from.read().await;
+    select_entries(&s, from, direction, future_only, limit_direction_departures)
+}
+
+// Arrivals at `from` in one snapshot, so callers can derive other values from the same one
+fn select_entries(
+    s: &MapByStop,
+    from: &str, direction: &str,
+    future_only: Option<bool>,
+    limit_direction_departures: Option<i8>
+) -> Vec<Entry> {
     let cache_from = &s.cache;
     let sample_time = s.sample_time.timestamp_millis() / 1000;
 
@@ -248,7 +260,7 @@ async fn next_train_handler(
 
 
     match cache_from.get(from) {
-        Some(entries) => Json(
+        Some(entries) => 
             entries.iter().filter(|e| 
                 !future_only || 
                 (e.arriving_at_timestamp - sample_time) >= 0
@@ -262,12 +274,90 @@ async fn next_train_handler(
                 limit_direction_departures <= 0 || direction_counters[e.direction.as_str()] <= limit_direction_departures
             })
             .map(|e| e.to_owned()).collect()
+        ,
+        None => vec![]
+    }
+}
+
+// Binary arrivals format, see next_stop::wire in esp/lib/NextStopClient/NextStopClient.hpp.
+// Fixed-width little-endian:
+//   header (16 bytes): 'N' 'S' | version u8 | record size u8 | count u32 | sample timestamp i64
+//   record (20 bytes): arriving_at i64 | leaving_at i64 | direction_id u16 | line_id u16
+const ARRIVALS_CONTENT_TYPE: &str = "application/x-next-stop";
+const ARRIVALS_VERSION: u8 = 1;
+const ARRIVALS_RECORD_SIZE: u8 = 20;
+
+fn wants_binary_arrivals(headers: &HeaderMap) -> bool {
+    headers.get(header::ACCEPT)
+        .and_then(|accept| accept.to_str().ok())
+        .map_or(false, |accept| 
+            accept.split(',').any(|media_type| media_type.trim().starts_with(ARRIVALS_CONTENT_TYPE))
+        )
+}
 
-        ),
-        None => Json(vec![])
+// Same values as config::Direction on the device: 0 unknown, 1 south, 2 north
+fn direction_id(direction: &str) -> u16 {
+    match direction.chars().last() {
+        Some('S') => 1,
+        Some('N') => 2,
+        _ => 0
     }
 }
 
+// Up to two ASCII characters of the route id, first character in the low byte
+fn line_id(line: &str) -> u16 {
+    let bytes = line.as_bytes();
+    (bytes.get(0).copied().unwrap_or(0) as u16) | ((bytes.get(1).copied().unwrap_or(0) as u16) << 8)
+}
+
+fn encode_arrivals(sample_time: i64, entries: &[Entry]) -> Vec<u8> {
+    let mut out = Vec::with_capacity(16 + entries.len() * ARRIVALS_RECORD_SIZE as usize);
+    out.extend_from_slice(b"NS");
+    out.push(ARRIVALS_VERSION);
+    out.push(ARRIVALS_RECORD_SIZE);
+    out.extend_from_slice(&(entries.len() as u32).to_le_bytes());
+    out.extend_from_slice(&sample_time.to_le_bytes());
+
+    for e in entries {
+        out.extend_from_slice(&e.arriving_at_timestamp.to_le_bytes());
+        out.extend_from_slice(&e.leaving_at_timestamp.to_le_bytes());
+        out.extend_from_slice(&direction_id(&e.direction).to_le_bytes());
+        out.extend_from_slice(&line_id(&e.line).to_le_bytes());
+    }
+    out
+}
+
+// Version of the cached snapshot: responses only change when the feed is refreshed
+async fn snapshot_version(state: &AppState) -> i64 {
+    state.cache_from.read().await.rts_timestamp.timestamp()
+}
+
+// Weak validator: the body also carries the response time, which doesn't change its meaning
+fn arrivals_etag(version: i64, binary: bool) -> String {
+    format!("W/\"{}-{}\"", version, if binary { "bin" } else { "json" })
+}
+
+fn etag_matches(headers: &HeaderMap, etag: &str) -> bool {
+    headers.get(header::IF_NONE_MATCH)
+        .and_then(|value| value.to_str().ok())
+        .map_or(false, |value| 
+            value.split(',').map(|tag| tag.trim()).any(|tag| tag == "*" || tag == etag)
+        )
+}
+
+// JSON unless the client asked for the binary arrivals format
+fn arrivals_response(headers: &HeaderMap, entries: Vec<Entry>) -> Response {
+    if wants_binary_arrivals(headers) {
+        let sample_time = Utc::now().timestamp_millis() / 1000;
+        return (
+            [(header::CONTENT_TYPE, ARRIVALS_CONTENT_TYPE)],
+            encode_arrivals(sample_time, &entries)
+        ).into_response();
+    }
+
+    Json(entries).into_response()
+}
+
 async fn all_next_train_handler(State(state): State<Arc<AppState>>) -> Json<serde_json::Value> {
     let mut s = state.cache_from.read().await;
     let cache_from = &s.cache;
@@ -288,6 +378,12 @@ async fn set_header<A>(State(state): State<Arc<AppState>>, mut response: Respons
     let timestamp_str = (Utc::now().timestamp_millis() / 1000).to_string();
 
     response.headers_mut().insert("x-timestamp", timestamp_str.parse().unwrap());
+
+    // Age of the realtime feed behind the data, so clients can time their polls to its refreshes
+    let feed_timestamp = snapshot_version(&state).await;
+    if feed_timestamp > 0 {
+        response.headers_mut().insert("x-feed-timestamp", feed_timestamp.to_string().parse().unwrap());
+    }
     response
 }
 
@@ -304,25 +400,45 @@ async fn web_server(_state: Arc<AppState>) {
         .route("/next_train/from/:from", get(
             |Path(from): Path<String>, Query(q): Query<NextTrainQuery>, state: State<Arc<AppState>>| async move { 
                 debug!("{}, {}", from, q.future_only.is_some());
-                next_train_handler(
+                Json(next_train_handler(
                     state, 
                     from.as_ref(),
                     "", 
                     q.future_only,
                     q.limit_direction_departures
-                ).await
+                ).await)
             }
         ))
         .route("/next_train/from/:from/direction/:direction", get(
-            |Path((from, direction)): Path<(String, String)>, Query(q): Query<NextTrainQuery>, state: State<Arc<AppState>>| async move { 
+            |Path((from, direction)): Path<(String, String)>, Query(q): Query<NextTrainQuery>, headers: HeaderMap, state: State<Arc<AppState>>| async move { 
                 debug!("from={}, future_only={}, direction={}", from, q.future_only.is_some(), direction);
-                next_train_handler(
-                    state, 
-                    from.as_ref(), 
-                    direction.as_ref(),
-                    q.future_only,
-                    q.limit_direction_departures
-                ).await
+                // The ETag and the body come from one read of the snapshot: a feed swapped in
+                // between would otherwise pair a new body with the old ETag
+                let (etag, entries) = {
+                    let s = state.cache_from.read().await;
+                    let etag = arrivals_etag(s.rts_timestamp.timestamp(), wants_binary_arrivals(&headers));
+                    if etag_matches(&headers, &etag) {
+                        // The format, and so the ETag, depends on Accept
+                        return (
+                            StatusCode::NOT_MODIFIED,
+                            [(header::ETAG, etag.as_str()), (header::VARY, "Accept")]
+                        ).into_response();
+                    }
+
+                    let entries = select_entries(
+                        &s,
+                        from.as_ref(),
+                        direction.as_ref(),
+                        q.future_only,
+                        q.limit_direction_departures
+                    );
+                    (etag, entries)
+                };
+
+                let mut response = arrivals_response(&headers, entries);
+                response.headers_mut().insert(header::ETAG, etag.parse().unwrap());
+                response.headers_mut().insert(header::VARY, "Accept".parse().unwrap());
+                response
             }
         ))
         .layer(map_response_with_state(_state.clone(), set_header))